@@ -20,12 +20,26 @@ struct type_env {
     Class_ c;
 };
 
+// The constructor that made a node.  Every phylum carries its kind so
+// that code can tell, say, a method from an attribute without RTTI.
+enum node_kind : unsigned char {
+   program_kind, class__kind, method_kind, attr_kind, formal_kind,
+   branch_kind, assign_kind, static_dispatch_kind, dispatch_kind,
+   cond_kind, loop_kind, typcase_kind, block_kind, let_kind, plus_kind,
+   sub_kind, mul_kind, divide_kind, neg_kind, lt_kind, eq_kind, leq_kind,
+   comp_kind, int_const_kind, bool_const_kind, string_const_kind,
+   new__kind, isvoid_kind, no_expr_kind, object_kind
+};
+
 // define the class for phylum
 // define simple phylum - Program
 typedef class Program_class *Program;
 
 class Program_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()      { return kind; }
    tree_node *copy()         { return copy_Program(); }
    virtual Program copy_Program() = 0;
 
@@ -41,7 +55,10 @@ public:
 typedef class Class__class *Class_;
 
 class Class__class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()      { return kind; }
    tree_node *copy()         { return copy_Class_(); }
    virtual Class_ copy_Class_() = 0;
 
@@ -60,7 +77,10 @@ public:
 typedef class Feature_class *Feature;
 
 class Feature_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()      { return kind; }
    tree_node *copy()         { return copy_Feature(); }
    virtual Feature copy_Feature() = 0;
 
@@ -77,7 +97,10 @@ public:
 typedef class Formal_class *Formal;
 
 class Formal_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()      { return kind; }
    tree_node *copy()         { return copy_Formal(); }
    virtual Formal copy_Formal() = 0;
 
@@ -94,7 +117,10 @@ public:
 typedef class Expression_class *Expression;
 
 class Expression_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()      { return kind; }
    tree_node *copy()         { return copy_Expression(); }
    virtual Expression copy_Expression() = 0;
 
@@ -110,7 +136,10 @@ public:
 typedef class Case_class *Case;
 
 class Case_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()      { return kind; }
    tree_node *copy()         { return copy_Case(); }
    virtual Case copy_Case() = 0;
 
@@ -157,6 +186,7 @@ protected:
    Classes classes;
 public:
    program_class(Classes a1) {
+      kind = program_kind;
       classes = a1;
    }
    Program copy_Program();
@@ -182,6 +212,7 @@ protected:
    Symbol filename;
 public:
    class__class(Symbol a1, Symbol a2, Features a3, Symbol a4) {
+      kind = class__kind;
       name = a1;
       parent = a2;
       features = a3;
@@ -222,6 +253,7 @@ protected:
    Expression expr;
 public:
    method_class(Symbol a1, Formals a2, Symbol a3, Expression a4) {
+      kind = method_kind;
       name = a1;
       formals = a2;
       return_type = a3;
@@ -262,6 +294,7 @@ protected:
    Expression init;
 public:
    attr_class(Symbol a1, Symbol a2, Expression a3) {
+      kind = attr_kind;
       name = a1;
       type_decl = a2;
       init = a3;
@@ -295,6 +328,7 @@ protected:
    Symbol type_decl;
 public:
    formal_class(Symbol a1, Symbol a2) {
+      kind = formal_kind;
       name = a1;
       type_decl = a2;
    }
@@ -326,6 +360,7 @@ protected:
    Expression expr;
 public:
    branch_class(Symbol a1, Symbol a2, Expression a3) {
+      kind = branch_kind;
       name = a1;
       type_decl = a2;
       expr = a3;
@@ -361,6 +396,7 @@ protected:
    Expression expr;
 public:
    assign_class(Symbol a1, Expression a2) {
+      kind = assign_kind;
       name = a1;
       expr = a2;
    }
@@ -391,6 +427,7 @@ protected:
    Expressions actual;
 public:
    static_dispatch_class(Expression a1, Symbol a2, Symbol a3, Expressions a4) {
+      kind = static_dispatch_kind;
       expr = a1;
       type_name = a2;
       name = a3;
@@ -418,6 +455,7 @@ protected:
    Expressions actual;
 public:
    dispatch_class(Expression a1, Symbol a2, Expressions a3) {
+      kind = dispatch_kind;
       expr = a1;
       name = a2;
       actual = a3;
@@ -444,6 +482,7 @@ protected:
    Expression else_exp;
 public:
    cond_class(Expression a1, Expression a2, Expression a3) {
+      kind = cond_kind;
       pred = a1;
       then_exp = a2;
       else_exp = a3;
@@ -469,6 +508,7 @@ protected:
    Expression body;
 public:
    loop_class(Expression a1, Expression a2) {
+      kind = loop_kind;
       pred = a1;
       body = a2;
    }
@@ -493,6 +533,7 @@ protected:
    Cases cases;
 public:
    typcase_class(Expression a1, Cases a2) {
+      kind = typcase_kind;
       expr = a1;
       cases = a2;
    }
@@ -516,6 +557,7 @@ protected:
    Expressions body;
 public:
    block_class(Expressions a1) {
+      kind = block_kind;
       body = a1;
    }
    Expression copy_Expression();
@@ -541,6 +583,7 @@ protected:
    Expression body;
 public:
    let_class(Symbol a1, Symbol a2, Expression a3, Expression a4) {
+      kind = let_kind;
       identifier = a1;
       type_decl = a2;
       init = a3;
@@ -567,6 +610,7 @@ protected:
    Expression e2;
 public:
    plus_class(Expression a1, Expression a2) {
+      kind = plus_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -591,6 +635,7 @@ protected:
    Expression e2;
 public:
    sub_class(Expression a1, Expression a2) {
+      kind = sub_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -615,6 +660,7 @@ protected:
    Expression e2;
 public:
    mul_class(Expression a1, Expression a2) {
+      kind = mul_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -639,6 +685,7 @@ protected:
    Expression e2;
 public:
    divide_class(Expression a1, Expression a2) {
+      kind = divide_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -662,6 +709,7 @@ protected:
    Expression e1;
 public:
    neg_class(Expression a1) {
+      kind = neg_kind;
       e1 = a1;
    }
    Expression copy_Expression();
@@ -685,6 +733,7 @@ protected:
    Expression e2;
 public:
    lt_class(Expression a1, Expression a2) {
+      kind = lt_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -709,6 +758,7 @@ protected:
    Expression e2;
 public:
    eq_class(Expression a1, Expression a2) {
+      kind = eq_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -733,6 +783,7 @@ protected:
    Expression e2;
 public:
    leq_class(Expression a1, Expression a2) {
+      kind = leq_kind;
       e1 = a1;
       e2 = a2;
    }
@@ -756,6 +807,7 @@ protected:
    Expression e1;
 public:
    comp_class(Expression a1) {
+      kind = comp_kind;
       e1 = a1;
    }
    Expression copy_Expression();
@@ -778,6 +830,7 @@ protected:
    Symbol token;
 public:
    int_const_class(Symbol a1) {
+      kind = int_const_kind;
       token = a1;
    }
    Expression copy_Expression();
@@ -800,6 +853,7 @@ protected:
    Boolean val;
 public:
    bool_const_class(Boolean a1) {
+      kind = bool_const_kind;
       val = a1;
    }
    Expression copy_Expression();
@@ -822,6 +876,7 @@ protected:
    Symbol token;
 public:
    string_const_class(Symbol a1) {
+      kind = string_const_kind;
       token = a1;
    }
    Expression copy_Expression();
@@ -844,6 +899,7 @@ protected:
    Symbol type_name;
 public:
    new__class(Symbol a1) {
+      kind = new__kind;
       type_name = a1;
    }
    Expression copy_Expression();
@@ -866,6 +922,7 @@ protected:
    Expression e1;
 public:
    isvoid_class(Expression a1) {
+      kind = isvoid_kind;
       e1 = a1;
    }
    Expression copy_Expression();
@@ -887,6 +944,7 @@ class no_expr_class : public Expression_class {
 protected:
 public:
    no_expr_class() {
+      kind = no_expr_kind;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
@@ -908,6 +966,7 @@ protected:
    Symbol name;
 public:
    object_class(Symbol a1) {
+      kind = object_kind;
       name = a1;
    }
    Expression copy_Expression();
@@ -928,6 +987,67 @@ public:
 };
 
 
+//
+// Checked downcasts and visitors that go by a node's kind.
+//
+//   as_method(f), as_attr(f)
+//      f as a method_class or attr_class, or NULL if it is the other.
+//
+//   visit(f, v), visit(e, v)
+//      call v.visit(n), where n is the feature f or expression e cast
+//      to the class of its constructor, and return the result.  V must
+//      define visit for each of those classes and a result_type.
+//
+inline method_class *as_method(Feature f)
+{
+   return f->get_kind() == method_kind ? static_cast<method_class *>(f) : NULL;
+}
+
+inline attr_class *as_attr(Feature f)
+{
+   return f->get_kind() == attr_kind ? static_cast<attr_class *>(f) : NULL;
+}
+
+template <class V> typename V::result_type visit(Feature f, V &v)
+{
+   if (f->get_kind() == method_kind)
+      return v.visit(static_cast<method_class *>(f));
+   else
+      return v.visit(static_cast<attr_class *>(f));
+}
+
+template <class V> typename V::result_type visit(Expression e, V &v)
+{
+   switch (e->get_kind()) {
+   case assign_kind:           return v.visit(static_cast<assign_class *>(e));
+   case static_dispatch_kind:  return v.visit(static_cast<static_dispatch_class *>(e));
+   case dispatch_kind:         return v.visit(static_cast<dispatch_class *>(e));
+   case cond_kind:             return v.visit(static_cast<cond_class *>(e));
+   case loop_kind:             return v.visit(static_cast<loop_class *>(e));
+   case typcase_kind:          return v.visit(static_cast<typcase_class *>(e));
+   case block_kind:            return v.visit(static_cast<block_class *>(e));
+   case let_kind:              return v.visit(static_cast<let_class *>(e));
+   case plus_kind:             return v.visit(static_cast<plus_class *>(e));
+   case sub_kind:              return v.visit(static_cast<sub_class *>(e));
+   case mul_kind:              return v.visit(static_cast<mul_class *>(e));
+   case divide_kind:           return v.visit(static_cast<divide_class *>(e));
+   case neg_kind:              return v.visit(static_cast<neg_class *>(e));
+   case lt_kind:               return v.visit(static_cast<lt_class *>(e));
+   case eq_kind:               return v.visit(static_cast<eq_class *>(e));
+   case leq_kind:              return v.visit(static_cast<leq_class *>(e));
+   case comp_kind:             return v.visit(static_cast<comp_class *>(e));
+   case int_const_kind:        return v.visit(static_cast<int_const_class *>(e));
+   case bool_const_kind:       return v.visit(static_cast<bool_const_class *>(e));
+   case string_const_kind:     return v.visit(static_cast<string_const_class *>(e));
+   case new__kind:             return v.visit(static_cast<new__class *>(e));
+   case isvoid_kind:           return v.visit(static_cast<isvoid_class *>(e));
+   case no_expr_kind:          return v.visit(static_cast<no_expr_class *>(e));
+   default:
+      return v.visit(static_cast<object_class *>(e));
+   }
+}
+
+
 // define the prototypes of the interface
 Classes nil_Classes();
 Classes single_Classes(Class_);
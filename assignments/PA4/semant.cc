@@ -7,17 +7,24 @@
 #include <map>
 
 #include "semant.h"
+#include "hierarchy.h"
 #include "utilities.h"
 
 extern int semant_debug;
 extern char *curr_filename;
 
-ClassTable *classtable;
+static ClassTable *classtable;
 
-std::map<Symbol, Class_> class_map;
+static std::map<Symbol, Class_> class_map;
+
+// The classes of class_map, numbered for subtype tests and joins.
+static ClassHierarchy hierarchy;
 
 typedef std::pair<Symbol, Symbol> method_id;
-std::map<method_id, method_class *> method_env;
+static std::map<method_id, method_class *> method_env;
+
+// The resolved methods of each class, by the index of its name in idtable.
+static std::vector<MethodTable *> method_tables;
 
 
 //////////////////////////////////////////////////////////////////////
@@ -254,23 +261,21 @@ method_class *method_in_cls(Symbol class_name, Symbol method_name) {
     return iter->second;
 }
 
+/*
+ * Returns the resolved methods of a class, or nullptr if it is not a class.
+ */
+MethodTable *get_method_table(Symbol class_name) {
+    unsigned int i = class_name->get_index();
+    return i < method_tables.size() ? method_tables[i] : nullptr;
+}
+
 /*
  * This is the get interface of the global Method Environment or formally it
  * returns the result of M(C,f).
  */
 method_class *lookup_method(Symbol class_name, Symbol method_name) {
-    for (auto c_iter = class_map.find(class_name);
-         c_iter != class_map.end();
-         c_iter = class_map.find(c_iter->second->get_parent())
-         ) {
-
-        method_class *method = method_in_cls(c_iter->second->get_name(), method_name);
-        if (method) {
-            return method;
-        }
-    }
-
-    return nullptr;
+    MethodTable *table = get_method_table(class_name);
+    return table ? table->lookup(method_name) : nullptr;
 }
 
 bool cls_is_defined(Symbol cls_name) {
@@ -295,17 +300,7 @@ bool is_subclass(Symbol sub, Symbol super, type_env &tenv) {
         sub = tenv.c->get_name();
     }
 
-    for (auto c_iter = class_map.find(sub);
-         c_iter != class_map.end();
-         c_iter = class_map.find(c_iter->second->get_parent())
-         ) {
-
-        if (c_iter->second->get_name() == super) {
-            return true;
-        }
-    }
-
-    return false;
+    return hierarchy.is_subclass(sub, super);
 }
 
 /*
@@ -319,12 +314,8 @@ Symbol cls_join(Symbol a, Symbol b, type_env &tenv) {
         b = tenv.c->get_name();
     }
 
-    Class_ cls = class_map[a];
-
-    for (; !is_subclass(b, cls->get_name(), tenv); cls = class_map[cls->get_parent()]) {
-    }
-
-    return cls->get_name();
+    Symbol join = hierarchy.lub(a, b);
+    return join ? join : Object;
 }
 
 // Type Checking Methods
@@ -852,6 +843,54 @@ Symbol object_class::typecheck(type_env &tenv) {
 
 // ------------------------
 
+/*
+ * Numbers the inheritance tree in class_map, which must be well-formed.
+ */
+void build_hierarchy() {
+    for (auto iter = class_map.begin(); iter != class_map.end(); iter++) {
+        hierarchy.add_class(iter->first, iter->second->get_parent());
+    }
+    hierarchy.build();
+}
+
+/*
+ * Builds the method table of cls, and those of its ancestors first if need
+ * be.  Where a class defines a method more than once, the table gets the
+ * definition method_env kept.
+ */
+void build_method_table(Class_ cls) {
+    std::vector<Class_> chain;
+    for (; cls && !get_method_table(cls->get_name()); cls = class_map[cls->get_parent()]) {
+        chain.push_back(cls);
+        if (cls->get_name() == Object) {
+            cls = nullptr;
+            break;
+        }
+    }
+
+    // cls is now the nearest ancestor with a table, if any
+    MethodTable *parent = cls ? get_method_table(cls->get_name()) : nullptr;
+    for (auto c_iter = chain.rbegin(); c_iter != chain.rend(); c_iter++) {
+        Class_ c = *c_iter;
+        MethodTable *table = parent ? new MethodTable(*parent) : new MethodTable();
+
+        Features features = c->get_features();
+        for (int i = features->first(); features->more(i); i = features->next(i)) {
+            method_class *method = as_method(features->nth(i));
+            if (method) {
+                table->add(c, method_in_cls(c->get_name(), method->get_name()));
+            }
+        }
+
+        unsigned int index = c->get_name()->get_index();
+        if (index >= method_tables.size()) {
+            method_tables.resize(index + 1, nullptr);
+        }
+        method_tables[index] = table;
+        parent = table;
+    }
+}
+
 /*
  * Builds the global method environment.
  */
@@ -863,7 +902,7 @@ void build_method_env() {
         for (int i = features->first(); features->more(i); i = features->next(i)) {
             Feature f = features->nth(i);
 
-            method_class *method = dynamic_cast<method_class *>(f);
+            method_class *method = as_method(f);
             if (!method) {
                 continue; // f is an attribute not a method, so skip it
             }
@@ -871,6 +910,10 @@ void build_method_env() {
             method_env[std::make_pair(cls->get_name(), f->get_name())] = method;
         }
     }
+
+    for (auto iter = class_map.begin(); iter != class_map.end(); iter++) {
+        build_method_table(iter->second);
+    }
 }
 
 /*
@@ -889,7 +932,7 @@ void build_initial_obj_env(type_env &tenv) {
         for (int i = features->first(); features->more(i); i = features->next(i)) {
             Feature f = features->nth(i);
 
-            attr_class *attribute = dynamic_cast<attr_class *>(f);
+            attr_class *attribute = as_attr(f);
             if (!attribute) {
                 continue; // f is a method not an attribute, so skip it
             }
@@ -903,7 +946,7 @@ void build_initial_obj_env(type_env &tenv) {
     for (int i = features->first(); features->more(i); i = features->next(i)) {
         Feature f = features->nth(i);
 
-        attr_class *attribute = dynamic_cast<attr_class *>(f);
+        attr_class *attribute = as_attr(f);
         if (!attribute) {
             continue; // f is a method not an attribute, so skip it
         }
@@ -961,6 +1004,9 @@ void program_class::check() {
  */
 void program_class::semant()
 {
+    if (semant_debug)
+        print_tree_stats(cerr, "before semant");
+
     initialize_constants();
 
     classtable = new ClassTable(classes);
@@ -970,6 +1016,7 @@ void program_class::semant()
         goto exit_error;
     }
 
+    build_hierarchy();
     build_method_env();
 
     check();
@@ -979,4 +1026,9 @@ void program_class::semant()
         cerr << "Compilation halted due to static semantic errors." << endl;
         exit(1);
     }
+
+    if (semant_debug) {
+        print_tree_stats(cerr, "semant");
+        print_string_table_stats(cerr);
+    }
 }
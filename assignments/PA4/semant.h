@@ -6,6 +6,7 @@
 #include "cool-tree.h"
 #include "stringtab.h"
 #include "symtab.h"
+#include "methodtab.h"
 #include "list.h"
 
 #define TRUE 1
@@ -33,4 +34,8 @@ public:
   ostream& semant_error(Symbol filename, tree_node *t);
 };
 
+// The methods of a class, inherited and its own, once semant has built
+// them; nullptr if class_name is not a class.
+MethodTable *get_method_table(Symbol class_name);
+
 #endif
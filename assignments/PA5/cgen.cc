@@ -21,22 +21,83 @@
 //
 //**************************************************************
 
-#include <map>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <unordered_set>
 #include <vector>
 
 #include "cgen.h"
 #include "cgen_gc.h"
+#include "peephole.h"
 
 
-std::map<Symbol, Class_> class_map;
-
-// the index of each class in this vector is its tag
+// the index of each class in this vector is its tag.  Classes are in
+// pre-order of the inheritance tree, so the classes that inherit from a
+// class have the tags right after its own.
 std::vector<Class_> cls_ordered;
 
+// the highest tag of a class that inherits from each class (or of the
+// class itself), by tag
+std::vector<int> last_subclass_tags;
+
+// the tag of each class, by the index of its name in idtable; -1 if the
+// symbol is not a class
+std::vector<int> class_tags;
+
+// the dispatch table of each class, by tag; slot i of the table is the
+// method called through offset i of the class's dispatch table
+std::vector<MethodTable> dispatch_tables;
+
+// for each class, by tag, whether the method in slot i of its dispatch
+// table is overridden by some class that inherits from it
+std::vector<std::vector<bool> > overridden_slots;
+
+// under -O, what the program can reach (see find_reachable): whether each
+// class is instantiated, whether its initializer runs and whether a
+// static dispatch reads its dispatch table, by tag, and the methods that
+// may be called
+static std::vector<bool> instantiated;
+static std::vector<bool> reached_inits;
+static std::vector<bool> read_tables;
+static std::unordered_set<method_class *> reached_methods;
+
+// under -O, the string and int constants the code refers to, by index
+static std::vector<bool> strings_used;
+static std::vector<bool> ints_used;
+
+// dynamic dispatches coded, and how many of them call their method directly
+static int dispatches = 0;
+static int direct_dispatches = 0;
+static int inlined_calls = 0;
+static int tail_calls = 0;
+
+// void checks at dispatches, and how many of them are left out
+static int void_checks = 0;
+static int void_checks_removed = 0;
+
+// the classes of cls_ordered, numbered for subtype tests (see hierarchy.h)
+ClassHierarchy class_hierarchy;
+
 int label_num = 0;
 
 extern void emit_string_constant(ostream& str, char *s);
 extern int cgen_debug;
+extern bool disable_reg_alloc;
+extern int cgen_optimize;
+extern int cgen_inline_size;
+extern int cgen_inline_depth;
+extern bool disable_tail_calls;
+
+static void fold_constants(Classes classes);
+static bool code_inline(dispatch_class *e, Class_ owner, method_class *m, int num_params,
+                        ostream &s, Environment &env);
+static bool dispatch_codes_call(dispatch_class *e, Environment &env);
+static bool is_non_void(Expression e, Environment &env);
+static bool assigns(Symbol name, Expression e);
+static void print_void_check_stats(ostream &out);
+static void print_reachability_stats(ostream &out);
 
 #define is_basic_class(name) ((name) == Object || (name) == IO || \
                               (name) == Str || (name) == Int || (name) == Bool)
@@ -144,13 +205,36 @@ BoolConst truebool(TRUE);
 
 void program_class::cgen(ostream &os)
 {
+    if (cgen_debug)
+        print_tree_stats(cerr, "before cgen");
+
+    // the program is built in memory and written out in one piece
+    AsmStream code;
+
     // spim wants comments to start with '#'
-    os << "# start of generated code\n";
+    code << "# start of generated code\n";
 
     initialize_constants();
-    CgenClassTable *codegen_classtable = new CgenClassTable(classes,os);
+    if (cgen_optimize) {
+        fold_constants(classes);
+    }
+    CgenClassTable *codegen_classtable = new CgenClassTable(classes,code);
+
+    code << "\n# end of generated code\n";
+    code.write_to(os);
 
-    os << "\n# end of generated code\n";
+    if (cgen_debug) {
+        print_tree_stats(cerr, "cgen");
+        print_string_table_stats(cerr);
+        if (cgen_optimize) {
+            print_peephole_stats(cerr);
+            cerr << "dispatch: " << direct_dispatches << " of " << dispatches
+                 << " called directly, " << inlined_calls << " inlined, "
+                 << tail_calls << " in tail position" << endl;
+            print_void_check_stats(cerr);
+            print_reachability_stats(cerr);
+        }
+    }
 }
 
 
@@ -237,17 +321,42 @@ static void emit_sub(char *dest, char *src1, char *src2, ostream& s)
 static void emit_sll(char *dest, char *src1, int num, ostream& s)
 { s << SLL << dest << " " << src1 << " " << num << endl; }
 
+static void emit_sra(char *dest, char *src1, int num, ostream& s)
+{ s << SRA << dest << " " << src1 << " " << num << endl; }
+
+static void emit_srl(char *dest, char *src1, int num, ostream& s)
+{ s << SRL << dest << " " << src1 << " " << num << endl; }
+
+static void emit_slt(char *dest, char *src1, char *src2, ostream& s)
+{ s << SLT << dest << " " << src1 << " " << src2 << endl; }
+
+static void emit_sltiu(char *dest, char *src1, int imm, ostream& s)
+{ s << SLTIU << dest << " " << src1 << " " << imm << endl; }
+
+static void emit_seq(char *dest, char *src1, char *src2, ostream& s)
+{ s << SEQ << dest << " " << src1 << " " << src2 << endl; }
+
+static void emit_xori(char *dest, char *src1, int imm, ostream& s)
+{ s << XORI << dest << " " << src1 << " " << imm << endl; }
+
+// jal and jalr emitted so far; a frame whose code adds none need not
+// save $ra (see end_frame)
+static int calls_coded = 0;
+
 static void emit_jalr(char *dest, ostream& s)
-{ s << JALR << "\t" << dest << endl; }
+{ s << JALR << "\t" << dest << endl; calls_coded++; }
+
+static void emit_jr(char *address, ostream& s)
+{ s << JR << address << endl; }
 
 static void emit_jal(char *address,ostream &s)
-{ s << JAL << address << endl; }
+{ s << JAL << address << endl; calls_coded++; }
 
 static void emit_return(ostream& s)
 { s << RET << endl; }
 
 static void emit_gc_assign(ostream& s)
-{ s << JAL << "_GenGC_Assign" << endl; }
+{ emit_jal("_GenGC_Assign", s); }
 
 static void emit_disptable_ref(Symbol sym, ostream& s)
 {  s << sym << DISPTAB_SUFFIX; }
@@ -264,6 +373,14 @@ static void emit_protobj_ref(Symbol sym, ostream& s)
 static void emit_method_ref(Symbol classname, Symbol methodname, ostream& s)
 { s << classname << METHOD_SEP << methodname; }
 
+static void emit_method_call(Symbol classname, Symbol methodname, ostream& s)
+{
+    s << JAL;
+    emit_method_ref(classname, methodname, s);
+    s << endl;
+    calls_coded++;
+}
+
 static void emit_label_def(int l, ostream &s)
 {
     emit_label_ref(l,s);
@@ -305,6 +422,20 @@ static void emit_blt(char *src1, char *src2, int label, ostream &s)
     s << endl;
 }
 
+static void emit_beqi(char *src1, int imm, int label, ostream &s)
+{
+    s << BEQ << src1 << " " << imm << " ";
+    emit_label_ref(label,s);
+    s << endl;
+}
+
+static void emit_bleqi(char *src1, int imm, int label, ostream &s)
+{
+    s << BLEQ << src1 << " " << imm << " ";
+    emit_label_ref(label,s);
+    s << endl;
+}
+
 static void emit_blti(char *src1, int imm, int label, ostream &s)
 {
     s << BLT << src1 << " " << imm << " ";
@@ -326,6 +457,13 @@ static void emit_branch(int l, ostream& s)
     s << endl;
 }
 
+static void emit_jump(int l, ostream& s)
+{
+    s << JUMP;
+    emit_label_ref(l,s);
+    s << endl;
+}
+
 //
 // Push a register on the stack. The stack grows towards smaller addresses.
 //
@@ -356,7 +494,7 @@ static void emit_test_collector(ostream &s)
     emit_push(ACC, s);
     emit_move(ACC, SP, s); // stack end
     emit_move(A1, ZERO, s); // allocate nothing
-    s << JAL << gc_collect_names[cgen_Memmgr] << endl;
+    emit_jal(gc_collect_names[cgen_Memmgr], s);
     emit_addiu(SP,SP,4,s);
     emit_load(ACC,0,SP,s);
 }
@@ -366,1361 +504,3802 @@ static void emit_gc_check(char *source, ostream &s)
     if (source != (char*)A1) {
         emit_move(A1, source, s);
     }
-    s << JAL << "_gc_check" << endl;
+    emit_jal("_gc_check", s);
 }
 
-
-///////////////////////////////////////////////////////////////////////////////
-//
-// coding strings, ints, and booleans
 //
-// Cool has three kinds of constants: strings, ints, and booleans.
-// This section defines code generation for each type.
-//
-// All string constants are listed in the global "stringtable" and have
-// type StringEntry.  StringEntry methods are defined both for String
-// constant definitions and references.
+// Method and initializer frames.  Below the saved $fp, self and $ra the
+// frame holds "slots" words for the values the body keeps (see hold_acc),
+// and below them the first "saved" temporary registers, which the body
+// may use.  $fp points at the saved $ra, so arguments and slots are at
+// the same offsets from it whatever is saved.
 //
-// All integer constants are listed in the global "inttable" and have
-// type IntEntry.  IntEntry methods are defined for Int
-// constant definitions and references.
+// Under -O a frame without slots saves $fp, self and $ra only if the
+// body uses them (see end_frame), and has no words for the others.  A
+// body that is known to make no calls keeps self in $t4 instead of $s0,
+// which it need not save, and one that uses no temporaries and does not
+// use $fp either gets no frame at all.
 //
-// Since there are only two Bool values, there is no need for a table.
-// The two booleans are represented by instances of the class BoolConst,
-// which defines the definition and reference methods for Bools.
+// A collector scans the whole frame, so the slots are cleared before the
+// body can store in them.
 //
-///////////////////////////////////////////////////////////////////////////////
+static char *temp_regs[NUM_TEMPS] = { S1, S2, S3, S4, S5, S6 };
 
-//
-// Strings
-//
-void StringEntry::code_ref(ostream& s)
-{
-    s << STRCONST_PREFIX << index;
-}
+#define FRAME_LINK_WORDS 3      // the saved $fp, self and $ra
 
-//
-// Emit code for a constant String.
-// You should fill in the code naming the dispatch table.
-//
+struct Frame {
+    bool fp;            // $fp is saved and set
+    bool self;          // self is saved and set from $a0
+    bool ra;            // $ra is saved
+    int saved;          // temporary registers saved
+    int slots;
 
-void StringEntry::code_def(ostream& s, int stringclasstag)
-{
-    IntEntryP lensym = inttable.add_int(len);
+    // the frame of a body that uses everything
+    Frame(int saved, int slots = 0) :
+        fp(true), self(true), ra(true), saved(saved), slots(slots) { }
 
-    // Add -1 eye catcher
-    s << WORD << "-1" << endl;
+    int words() const {
+        if (slots > 0) {
+            return FRAME_LINK_WORDS + slots + saved;
+        }
+        return fp + self + ra + saved;
+    }
+};
 
-    code_ref(s);
-    s << LABEL                                                          // label
-      << WORD << stringclasstag << endl                                 // tag
-      << WORD << (DEFAULT_OBJFIELDS + STRING_SLOTS + (len+4)/4) << endl // size
-      << WORD;
+static void emit_prologue(const Frame &f, ostream &s)
+{
+    int words = f.words();
+    int pos = words;
+    if (words > 0) {
+        emit_addiu(SP, SP, -(words * 4), s);
+    }
+    if (f.fp) {
+        emit_store(FP, pos--, SP, s);
+    }
+    if (f.self) {
+        emit_store(SELF, pos--, SP, s);
+    }
+    if (f.ra) {
+        emit_store(RA, pos--, SP, s);
+    }
+    for (int i = 0; i < f.saved; i++) {
+        emit_store(temp_regs[i], f.saved - i, SP, s);
+    }
+    if (cgen_Memmgr != GC_NOGC) {
+        for (int i = 0; i < f.slots; i++) {
+            emit_store(ZERO, f.slots + f.saved - i, SP, s);
+        }
+    }
+    if (f.fp) {
+        // the saved $ra, the last of the link words
+        emit_addiu(FP, SP, 4 * (words - (FRAME_LINK_WORDS - 1)), s);
+    }
+    if (f.self) {
+        emit_move(SELF, ACC, s);
+    }
+}
 
-    /***** Add dispatch information for class String ******/
-    s << Str << DISPTAB_SUFFIX;
+// Restores the caller's registers from a frame "above" words above $sp.
+static void emit_restore(const Frame &f, int above, ostream &s)
+{
+    int pos = f.words() + above;
+    if (f.fp) {
+        emit_load(FP, pos--, SP, s);
+    }
+    if (f.self) {
+        emit_load(SELF, pos--, SP, s);
+    }
+    if (f.ra) {
+        emit_load(RA, pos--, SP, s);
+    }
+    for (int i = 0; i < f.saved; i++) {
+        emit_load(temp_regs[i], f.saved - i + above, SP, s);
+    }
+}
 
-    s << endl;                                                  // dispatch table
-    s << WORD;
-    lensym->code_ref(s);
-    s << endl;                                                  // string length
-    emit_string_constant(s,str);                                // ascii string
-    s << ALIGN;                                                 // align to word
+// Restores the caller's registers and pops the frame and the args
+// arguments above it.
+static void emit_epilogue(const Frame &f, int args, ostream &s)
+{
+    int words = f.words();
+    emit_restore(f, 0, s);
+    if (words + args > 0) {
+        emit_addiu(SP, SP, (words + args) * 4, s);
+    }
 }
 
 //
-// StrTable::code_string
-// Generate a string object definition for every string constant in the
-// stringtable.
+// Under -O each method and initializer is generated into a buffer of its
+// own and written out through the peephole optimizer (see peephole.h).
 //
-void StrTable::code_string_table(ostream& s, int stringclasstag)
+#define METHOD_BUFFER_SIZE 4096
+
+static ostream &method_stream(AsmStream &buffer, ostream &out)
 {
-    for (List<StringEntry> *l = tbl; l; l = l->tl()) {
-        l->hd()->code_def(s,stringclasstag);
+    if (cgen_optimize) {
+        return buffer;
     }
+    return out;
 }
 
-//
-// Ints
-//
-void IntEntry::code_ref(ostream &s)
+static void end_method(AsmStream &buffer, ostream &out)
 {
-    s << INTCONST_PREFIX << index;
+    if (cgen_optimize) {
+        peephole_optimize(buffer.data(), buffer.size(), out);
+    }
 }
 
 //
-// Emit code for a constant Integer.
-// You should fill in the code naming the dispatch table.
+// Temporaries.  A value that has to be kept while another expression is
+// evaluated (the left operand of an arithmetic operator, a let variable,
+// a case scrutinee) goes in one of the temp_regs when enough of them are
+// free, and on the stack otherwise.
+//
+// Under -O frames have a fixed size: instead of being pushed and popped,
+// a value that does not get a register is stored in a slot of the frame,
+// at a fixed offset from $fp.  Slots are taken in stack order, like the
+// registers, and the frame has as many as the body uses at once.
+//
+// TempCounter gives each expression its Sethi-Ullman number: the number
+// of registers it needs to keep all of its own intermediate values in
+// registers.  Operands are evaluated left to right, so a binary operator
+// needs max(n1, n2 + 1).  A value is put in a register only when the
+// expression evaluated while it is held leaves one free, so an
+// expression never uses more registers than its number; spills happen
+// in the outer expressions, which run less often.
 //
+// The registers are preserved across calls by the callee: a method saves
+// the ones its body uses in its frame.
+//
+static int temps_needed(Expression e);
+static int temps_needed(Cases cases);
+static bool may_call(Expression e);
 
-void IntEntry::code_def(ostream &s, int intclasstag)
+struct TempCounter {
+    typedef int result_type;
+
+    static int held_across(int held, Expression e) {
+        return std::max(held, temps_needed(e) + 1);
+    }
+
+    static int held_across(int held, Cases cases) {
+        return std::max(held, temps_needed(cases) + 1);
+    }
+
+    static int max_of(Expressions es) {
+        int n = 0;
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            n = std::max(n, temps_needed(es->nth(i)));
+        }
+        return n;
+    }
+
+    int visit(assign_class *e)          { return temps_needed(e->expr); }
+    int visit(static_dispatch_class *e) { return std::max(max_of(e->actual), temps_needed(e->expr)); }
+    int visit(dispatch_class *e)        { return std::max(max_of(e->actual), temps_needed(e->expr)); }
+    int visit(cond_class *e)            { return std::max(temps_needed(e->pred),
+                                                 std::max(temps_needed(e->then_exp), temps_needed(e->else_exp))); }
+    int visit(loop_class *e)            { return std::max(temps_needed(e->pred), temps_needed(e->body)); }
+    int visit(block_class *e)           { return max_of(e->body); }
+    int visit(let_class *e)             { return held_across(temps_needed(e->init), e->body); }
+    int visit(plus_class *e)            { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(sub_class *e)             { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(mul_class *e)             { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(divide_class *e)          { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(lt_class *e)              { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(eq_class *e)              { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(leq_class *e)             { return held_across(temps_needed(e->e1), e->e2); }
+    int visit(neg_class *e)             { return temps_needed(e->e1); }
+    int visit(comp_class *e)            { return temps_needed(e->e1); }
+    int visit(isvoid_class *e)          { return temps_needed(e->e1); }
+    int visit(int_const_class *e)       { return 0; }
+    int visit(bool_const_class *e)      { return 0; }
+    int visit(string_const_class *e)    { return 0; }
+    int visit(new__class *e)            { return 0; }
+    int visit(no_expr_class *e)         { return 0; }
+    int visit(object_class *e)          { return 0; }
+
+    int visit(typcase_class *e)         { return held_across(temps_needed(e->expr), e->cases); }
+};
+
+static int temps_needed(Expression e)
 {
-    // Add -1 eye catcher
-    s << WORD << "-1" << endl;
+    if (e->temps < 0) {
+        TempCounter counter;
+        e->temps = visit(e, counter);
+    }
+    return e->temps;
+}
 
-    code_ref(s);
-    s << LABEL                                            // label
-      << WORD << intclasstag << endl                      // class tag
-      << WORD << (DEFAULT_OBJFIELDS + INT_SLOTS) << endl  // object size
-      << WORD;
+// the most any branch of a case needs
+static int temps_needed(Cases cases)
+{
+    int n = 0;
+    for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+        n = std::max(n, temps_needed(cases->nth(i)->get_expr()));
+    }
+    return n;
+}
 
-    /***** Add dispatch information for class Int ******/
-    s << Int << DISPTAB_SUFFIX;
+// the number of registers a frame whose body needs "needed" should save
+static int temps_saved(int needed)
+{
+    return disable_reg_alloc ? 0 : std::min(needed, NUM_TEMPS);
+}
 
-    s << endl;                                          // dispatch table
-    s << WORD << str << endl;                           // integer value
+static bool fixed_frames()
+{
+    return cgen_optimize;
+}
+
+// the offset from $fp, in words, of a frame slot
+static int slot_offset(int slot)
+{
+    return -(1 + slot);
 }
 
+// Takes a temporary register if one will still be free for an expression
+// that needs "needed"; returns NULL if the value has to go on the stack.
+static char *take_temp(int needed, Environment &env)
+{
+    if (disable_reg_alloc || NUM_TEMPS - env.get_temps_in_use() <= needed) {
+        return NULL;
+    }
+    return temp_regs[env.alloc_temp()];
+}
 
-//
-// IntTable::code_string_table
-// Generate an Int object definition for every Int constant in the
-// inttable.
-//
-void IntTable::code_string_table(ostream &s, int intclasstag)
+// Keeps $a0 while "next" is evaluated, in a register, a slot or on the
+// stack.  Across code that makes no call it is still pushed: the peephole
+// optimizer turns such a push and pop into a move.  Returns the register,
+// or NULL.
+static char *hold_acc(Expression next, ostream &s, Environment &env)
 {
-    for (List<IntEntry> *l = tbl; l; l = l->tl()) {
-        l->hd()->code_def(s,intclasstag);
+    char *reg = take_temp(temps_needed(next), env);
+    if (reg) {
+        emit_move(reg, ACC, s);
+    } else if (fixed_frames() && may_call(next)) {
+        emit_store(ACC, slot_offset(env.alloc_slot()), env.use_fp(), s);
+    } else {
+        emit_push(ACC, s);
+        env.push_stack_symbol(No_type);
     }
+    return reg;
 }
 
+// Releases a value kept by hold_acc across "next" and returns the
+// register it is in, loading it into "dest" if it was in a slot or on
+// the stack.
+static char *release_held(char *reg, Expression next, char *dest, ostream &s, Environment &env)
+{
+    if (reg) {
+        env.free_temp();
+        return reg;
+    }
+    if (fixed_frames() && may_call(next)) {
+        env.free_slot();
+        emit_load(dest, slot_offset(env.get_slots_in_use()), env.use_fp(), s);
+        return dest;
+    }
+    emit_addiu(SP, SP, 4, s);
+    emit_load(dest, 0, SP, s);
+    env.pop_stack_symbol();
+    return dest;
+}
 
 //
-// Bools
+// Calls inlined into a body (see code_inline) use temporaries the body's
+// own count does not include.  Under -O the body is therefore coded into
+// a buffer first, and the prologue, which saves the temporaries used and
+// makes room for the slots used, is written after it.  The environment
+// records whether the body used $fp and self, and calls_coded whether it
+// made calls, which tells which of $fp, self and $ra the frame has to
+// save.  A leaf body, one that codes_call says makes no calls, keeps self
+// in $t4 instead.  begin_frame() returns the stream to code the body to,
+// and end_frame() the frame, for the epilogue.
 //
-BoolConst::BoolConst(int i) : val(i) { assert(i == 0 || i == 1); }
+static int frame_calls;         // calls_coded when the body was begun
+static bool frame_leaf;         // the body keeps self in $t4
 
-void BoolConst::code_ref(ostream& s) const
+static ostream &begin_frame(int needed, bool leaf, AsmStream &body, ostream &s, Environment &env)
 {
-    s << BOOLCONST_PREFIX << val;
+    env.reset_temps_used();
+    frame_calls = calls_coded;
+    frame_leaf = cgen_optimize && leaf;
+    if (frame_leaf) {
+        env.start_frame(T4);
+    } else {
+        env.start_frame(SELF);
+    }
+    if (cgen_optimize) {
+        return body;
+    }
+    emit_prologue(Frame(temps_saved(needed)), s);
+    return s;
+}
+
+static Frame end_frame(int needed, AsmStream &body, ostream &s, Environment &env)
+{
+    Frame f(temps_saved(std::max(needed, env.get_temps_used())), env.get_slots_used());
+    if (!cgen_optimize) {
+        return f;
+    }
+
+    // $t4 does not survive a call
+    assert(!frame_leaf || calls_coded == frame_calls);
+    if (f.slots == 0) {
+        f.fp = env.uses_fp();
+        f.ra = calls_coded > frame_calls;
+        f.self = env.uses_self() && !frame_leaf;
+    }
+    emit_prologue(f, s);
+    if (frame_leaf && env.uses_self()) {
+        emit_move(T4, ACC, s);
+    }
+    if (env.get_loop_label() >= 0) {
+        // see code_tail_call
+        emit_label_def(env.get_loop_label(), s);
+    }
+    body.write_to(s);
+    return f;
 }
 
 //
-// Emit code for a constant Bool.
-// You should fill in the code naming the dispatch table.
+// Dispatch on void.  Without -O every dispatch checks its receiver in
+// line.  Under -O the check is left out where the receiver cannot be
+// void (see is_non_void), and otherwise it is a single branch to code
+// after the method, which loads the line number and goes to the abort
+// stub of the class's file; the stubs follow all the methods.
 //
+struct AbortCall {
+    int label;
+    int line;
+    int file;           // index of the file name in stringtable
+};
 
-void BoolConst::code_def(ostream& s, int boolclasstag)
+static std::vector<AbortCall> abort_calls;      // of the method being coded
+static std::vector<bool> void_dispatch_stubs;   // by file name index
+
+static void emit_void_dispatch_ref(int file, ostream &s)
+{ s << VOID_DISPATCH_PREFIX << file; }
+
+// Checks the receiver expr, now in $a0, of a dispatch at line.
+static void code_void_check(Expression expr, int line, ostream &s, Environment &env)
 {
-    // Add -1 eye catcher
-    s << WORD << "-1" << endl;
+    StringEntryP file = stringtable.lookup_string(env.get_cls()->get_filename()->get_string());
+    void_checks++;
 
-    code_ref(s);
-    s << LABEL                                              // label
-      << WORD << boolclasstag << endl                       // class tag
-      << WORD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << endl   // object size
-      << WORD;
+    if (!cgen_optimize) {
+        // if $a0 != 0 then jump to labelx
+        emit_bne(ACC, ZERO, label_num, s);
 
-    /***** Add dispatch information for class Bool ******/
-    s << Bool << DISPTAB_SUFFIX;
+        emit_partial_load_address(ACC, s);
+        file->code_ref(s);
+        s << endl;
+        emit_load_imm(T1, line, s);
+        emit_jal("_dispatch_abort", s);
 
-    s << endl;                                            // dispatch table
-    s << WORD << val << endl;                             // value (0 or 1)
+        // labelx...
+        emit_label_def(label_num++, s);
+        return;
+    }
+
+    if (is_non_void(expr, env)) {
+        void_checks_removed++;
+        return;
+    }
+
+    AbortCall call = { label_num++, line, file->get_index() };
+    abort_calls.push_back(call);
+    emit_beqz(ACC, call.label, s);
+
+    if (call.file >= (int) void_dispatch_stubs.size()) {
+        void_dispatch_stubs.resize(call.file + 1, false);
+    }
+    void_dispatch_stubs[call.file] = true;
+}
+
+// Codes the abort calls of the method just coded.
+static void code_abort_calls(ostream &s)
+{
+    for (auto call : abort_calls) {
+        emit_label_def(call.label, s);
+        emit_load_imm(T1, call.line, s);
+        s << BRANCH;
+        emit_void_dispatch_ref(call.file, s);
+        s << endl;
+    }
+    abort_calls.clear();
+}
+
+void CgenClassTable::code_void_dispatch_stubs()
+{
+    for (int i = 0; i < (int) void_dispatch_stubs.size(); i++) {
+        if (void_dispatch_stubs[i]) {
+            emit_void_dispatch_ref(i, str);
+            str << LABEL;
+            emit_partial_load_address(ACC, str);
+            stringtable.lookup(i)->code_ref(str);
+            str << endl;
+            str << BRANCH << "_dispatch_abort" << endl;
+        }
+    }
+}
+
+static void print_void_check_stats(ostream &out)
+{
+    int stubs = std::count(void_dispatch_stubs.begin(), void_dispatch_stubs.end(), true);
+    int kept = void_checks - void_checks_removed;
+    // a check was 4 instructions; a kept one is 3, and each stub 2
+    int saved = 4 * void_checks_removed + kept - 2 * stubs;
+    out << "void checks: " << void_checks_removed << " of " << void_checks
+        << " removed, " << saved << " instructions (" << 4 * saved << " bytes) saved" << endl;
 }
 
-//////////////////////////////////////////////////////////////////////////////
 //
-//  CgenClassTable methods
+// Tail calls.  Under -O a direct call (see overridden_slots) that is the
+// last thing its method does does not come back to the method.  Its
+// arguments are pushed and its receiver checked as for any call; then
 //
-//////////////////////////////////////////////////////////////////////////////
-
-//***************************************************
+//   - a call of the method itself stores the arguments over the
+//     method's own, sets self to the receiver and branches back to the
+//     start of the body, after the prologue;
 //
-//  Emit code to start the .data segment and to
-//  declare the global names.
+//   - a call of another method branches to code after the method (see
+//     code_tail_jumps), where the frame is known: it restores what the
+//     prologue saved, moves the arguments up to end where the method's
+//     own end, pops everything below them and jumps to the method, which
+//     returns to the method's caller.
 //
-//***************************************************
+// Either way the stack does not grow, so a method can recurse without
+// bound this way.  Calls in inlined bodies are not in tail position.
+// -n turns tail calls off.
+//
+struct TailMarker {
+    typedef void result_type;
 
-void CgenClassTable::code_global_data()
+    static void mark(Expression e) {
+        TailMarker marker;
+        ::visit(e, marker);
+    }
+
+    template <class E> void visit(E *e)  { }
+
+    void visit(dispatch_class *e)       { e->tail = true; }
+    void visit(cond_class *e)           { mark(e->then_exp); mark(e->else_exp); }
+    void visit(block_class *e)          { mark(e->body->nth(e->body->len() - 1)); }
+    void visit(let_class *e)            { mark(e->body); }
+
+    void visit(typcase_class *e) {
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            mark(e->cases->nth(i)->get_expr());
+        }
+    }
+};
+
+// Marks the calls in tail position in the body of a method.
+static void mark_tail_calls(Expression body)
 {
-    Symbol main    = idtable.lookup_string(MAINNAME);
-    Symbol string  = idtable.lookup_string(STRINGNAME);
-    Symbol integer = idtable.lookup_string(INTNAME);
-    Symbol boolc   = idtable.lookup_string(BOOLNAME);
+    if (cgen_optimize && !disable_tail_calls) {
+        TailMarker::mark(body);
+    }
+}
 
-    str << "\t.data\n" << ALIGN;
-    //
-    // The following global names must be defined first.
-    //
-    str << GLOBAL << CLASSNAMETAB << endl;
-    str << GLOBAL; emit_protobj_ref(main,str);    str << endl;
-    str << GLOBAL; emit_protobj_ref(integer,str); str << endl;
-    str << GLOBAL; emit_protobj_ref(string,str);  str << endl;
-    str << GLOBAL; falsebool.code_ref(str);  str << endl;
-    str << GLOBAL; truebool.code_ref(str);   str << endl;
-    str << GLOBAL << INTTAG << endl;
-    str << GLOBAL << BOOLTAG << endl;
-    str << GLOBAL << STRINGTAG << endl;
+struct TailJump {
+    int label;
+    Class_ owner;
+    Symbol name;
+    int args;
+};
 
-    //
-    // We also need to know the tag of the Int, String, and Bool classes
-    // during code generation.
-    //
-    str << INTTAG << LABEL
-        << WORD << intclasstag << endl;
-    str << BOOLTAG << LABEL
-        << WORD << boolclasstag << endl;
-    str << STRINGTAG << LABEL
-        << WORD << stringclasstag << endl;
+static std::vector<TailJump> tail_jumps;        // of the method being coded
+
+// Codes the call e of method m, defined in class owner, as a tail call if
+// it is one; num_params arguments have been pushed and the receiver is
+// in $a0.  Returns false if it is not coded.
+static bool code_tail_call(dispatch_class *e, Class_ owner, method_class *m, int num_params,
+                           ostream &s, Environment &env)
+{
+    if (!e->tail || env.get_inline_depth() > 0) {
+        return false;
+    }
+    tail_calls++;
+
+    if (m != env.get_mth()) {
+        TailJump jump = { label_num++, owner, m->get_name(), num_params };
+        tail_jumps.push_back(jump);
+        emit_branch(jump.label, s);
+        return true;
+    }
+
+    // the first argument was pushed first, so it is the deepest
+    for (int i = 0; i < num_params; i++) {
+        emit_load(T1, num_params - i, SP, s);
+        emit_store(T1, 2 + num_params - i, env.use_fp(), s);
+    }
+    if (num_params > 0) {
+        emit_addiu(SP, SP, 4 * num_params, s);
+    }
+    if (!(e->expr->get_kind() == object_kind && static_cast<object_class *>(e->expr)->name == self)) {
+        emit_move(env.use_self(), ACC, s);
+    }
+    if (env.get_loop_label() < 0) {
+        env.set_loop_label(label_num++);
+    }
+    emit_branch(env.get_loop_label(), s);
+    return true;
 }
 
+// Codes the jumps to other methods of the method just coded, which has
+// frame f and args arguments.
+static void code_tail_jumps(const Frame &f, int args, ostream &s)
+{
+    for (auto jump : tail_jumps) {
+        // the pushed arguments are at the bottom, below the frame
+        int words = f.words();
+        emit_label_def(jump.label, s);
+        emit_restore(f, jump.args, s);
+        if (words + args > 0) {
+            for (int i = 0; i < jump.args; i++) {
+                emit_load(T1, jump.args - i, SP, s);
+                emit_store(T1, jump.args - i + words + args, SP, s);
+            }
+            emit_addiu(SP, SP, 4 * (words + args), s);
+        }
+        s << JUMP;
+        emit_method_ref(jump.owner->get_name(), jump.name, s);
+        s << endl;
+    }
+    tail_jumps.clear();
+}
 
-//***************************************************
 //
-//  Emit code to start the .text segment and to
-//  declare the global names.
+// Unboxed Int and Bool values.  Under -O an Int or Bool that is only
+// computed with (an operand of arithmetic or of a comparison, the
+// predicate of a conditional or a loop, a let variable) stays a machine
+// word: code_value() leaves it in $a0, a Bool as 0 or 1, and it is boxed
+// only where an object is needed.
 //
-//***************************************************
+// A raw word must not be where the collector looks for pointers.  With
+// the generational collector a raw operand is held in $t5 or $t6, which
+// it does not scan, and only across an expression that calls no method,
+// since the callee may use them too; otherwise the boxed operand is held.
+// Let variables are raw only without a collector.
+//
+static char *raw_temp_regs[NUM_RAW_TEMPS] = { T5, T6 };
 
-void CgenClassTable::code_global_text()
+static void code_value(Expression e, ostream &s, Environment &env);
+static void code_effect(Expression e, ostream &s, Environment &env);
+static bool int_value(Expression e, int &value);
+static bool has_raw_code(Expression e, Environment &env);
+
+static bool unboxing()
 {
-    str << GLOBAL << HEAP_START << endl
-        << HEAP_START << LABEL
-        << WORD << 0 << endl
-        << "\t.text" << endl
-        << GLOBAL;
-    emit_init_ref(idtable.add_string("Main"), str);
-    str << endl << GLOBAL;
-    emit_init_ref(idtable.add_string("Int"),str);
-    str << endl << GLOBAL;
-    emit_init_ref(idtable.add_string("String"),str);
-    str << endl << GLOBAL;
-    emit_init_ref(idtable.add_string("Bool"),str);
-    str << endl << GLOBAL;
-    emit_method_ref(idtable.add_string("Main"), idtable.add_string("main"), str);
-    str << endl;
+    return cgen_optimize;
 }
 
-void CgenClassTable::code_bools(int boolclasstag)
+static bool is_unboxed_type(Symbol type)
 {
-    falsebool.code_def(str,boolclasstag);
-    truebool.code_def(str,boolclasstag);
+    return type == Int || type == Bool;
 }
 
-void CgenClassTable::code_select_gc()
+static bool raw_let_vars()
 {
-    //
-    // Generate GC choice constants (pointers to GC functions)
-    //
-    str << GLOBAL << "_MemMgr_INITIALIZER" << endl;
-    str << "_MemMgr_INITIALIZER:" << endl;
-    str << WORD << gc_init_names[cgen_Memmgr] << endl;
-    str << GLOBAL << "_MemMgr_COLLECTOR" << endl;
-    str << "_MemMgr_COLLECTOR:" << endl;
-    str << WORD << gc_collect_names[cgen_Memmgr] << endl;
-    str << GLOBAL << "_MemMgr_TEST" << endl;
-    str << "_MemMgr_TEST:" << endl;
-    str << WORD << (cgen_Memmgr_Test == GC_TEST) << endl;
+    return unboxing() && cgen_Memmgr == GC_NOGC;
 }
 
+// Does e = f compare Int or Bool values?  Otherwise it compares objects.
+static bool compares_values(eq_class *e)
+{
+    return is_unboxed_type(e->e1->get_type()) && e->e1->get_type() == e->e2->get_type();
+}
 
-//********************************************************
-//
-// Emit code to reserve space for and initialize all of
-// the constants.  Class names should have been added to
-// the string table (in the supplied code, is is done
-// during the construction of the inheritance graph), and
-// code for emitting string constants as a side effect adds
-// the string's length to the integer table.  The constants
-// are emmitted by running through the stringtable and inttable
-// and producing code for each entry.
-//
-//********************************************************
-
-void CgenClassTable::code_constants()
+// Boxes the raw value in $a0 into an object of class type, Int or Bool.
+static void emit_box(Symbol type, ostream &s)
 {
-    //
-    // Add constants that are required by the code generator.
-    //
-    stringtable.add_string("");
-    inttable.add_string("0");
+    if (type == Int) {
+        emit_move(T7, ACC, s);
+        emit_partial_load_address(ACC, s);
+        emit_protobj_ref(Int, s);
+        s << endl;
+        emit_jal("Object.copy", s);
+        emit_store_int(T7, ACC, s);
+        return;
+    }
 
-    stringtable.code_string_table(str,stringclasstag);
-    inttable.code_string_table(str,intclasstag);
-    code_bools(boolclasstag);
+    emit_move(T1, ACC, s);
+    emit_load_bool(ACC, BoolConst(1), s);
+    emit_bne(T1, ZERO, label_num, s);
+    emit_load_bool(ACC, BoolConst(0), s);
+    emit_label_def(label_num++, s);
 }
 
-int get_class_tag(Symbol name)
-{
-    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
-        if (cls_ordered[i]->get_name() == name) {
-            return i;
+struct CallFinder {
+    typedef bool result_type;
+
+    static bool any(Expressions es) {
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            if (may_call(es->nth(i))) {
+                return true;
+            }
         }
+        return false;
     }
 
-    return -1;
-}
+    bool visit(assign_class *e)          { return may_call(e->expr); }
+    bool visit(static_dispatch_class *e) { return true; }
+    bool visit(dispatch_class *e)        { return true; }
+    bool visit(cond_class *e)            { return may_call(e->pred) || may_call(e->then_exp) || may_call(e->else_exp); }
+    bool visit(loop_class *e)            { return may_call(e->pred) || may_call(e->body); }
+    bool visit(block_class *e)           { return any(e->body); }
+    bool visit(let_class *e)             { return may_call(e->init) || may_call(e->body); }
+    bool visit(plus_class *e)            { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(sub_class *e)             { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(mul_class *e)             { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(divide_class *e)          { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(lt_class *e)              { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(eq_class *e)              { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(leq_class *e)             { return may_call(e->e1) || may_call(e->e2); }
+    bool visit(neg_class *e)             { return may_call(e->e1); }
+    bool visit(comp_class *e)            { return may_call(e->e1); }
+    bool visit(isvoid_class *e)          { return may_call(e->e1); }
+    bool visit(int_const_class *e)       { return false; }
+    bool visit(bool_const_class *e)      { return false; }
+    bool visit(string_const_class *e)    { return false; }
+    bool visit(new__class *e)            { return true; }     // the initializer
+    bool visit(no_expr_class *e)         { return false; }
+    bool visit(object_class *e)          { return false; }
+
+    bool visit(typcase_class *e) {
+        if (may_call(e->expr)) {
+            return true;
+        }
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            if (may_call(e->cases->nth(i)->get_expr())) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
-CgenClassTable::CgenClassTable(Classes classes, ostream& s) : nds(NULL) , str(s)
+// Does e call a method?  The runtime routines it may call (Object.copy,
+// equality_test) leave $t5 and $t6 alone.
+static bool may_call(Expression e)
 {
-    enterscope();
-    if (cgen_debug) {
-        cout << "Building CgenClassTable" << endl;
+    if (e->calls < 0) {
+        CallFinder finder;
+        e->calls = visit(e, finder);
     }
+    return e->calls;
+}
 
-    install_basic_classes();
+//
+// Is the variable "name" read as an object in e?  A raw variable has to
+// be boxed there, which costs more than the fetches it saves.  "value"
+// says whether e itself is coded for its raw value.  Shadowing, and
+// whether the variables of inner lets end up raw, are not taken into
+// account, so the answer is an estimate.
+//
+static bool read_boxed(Symbol name, Expression e, bool value);
 
-    // push the rest of the classes in cls_ordered
-    for (int i = classes->first(); classes->more(i); i = classes->next(i)) {
-        Class_ cls = classes->nth(i);
-        cls_ordered.push_back(cls);
-        class_map.insert(std::make_pair(cls->get_name(), cls));
+struct BoxedRead {
+    typedef bool result_type;
+
+    Symbol name;
+    bool value;
+
+    bool in(Expression e, bool v) {
+        return read_boxed(name, e, v);
     }
 
-    intclasstag = get_class_tag(Int);
-    boolclasstag = get_class_tag(Bool);
-    stringclasstag = get_class_tag(Str);
+    bool in(Expressions es) {
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            if (in(es->nth(i), false)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-    install_classes(classes);
-    build_inheritance_tree();
+    bool operands(Expression e1, Expression e2) {
+        return in(e1, true) || in(e2, true);
+    }
 
-    code();
-    exitscope();
-}
+    bool visit(assign_class *e)          { return (e->name == name && !value) || in(e->expr, e->name == name); }
+    bool visit(static_dispatch_class *e) { return in(e->actual) || in(e->expr, false); }
+    bool visit(dispatch_class *e)        { return in(e->actual) || in(e->expr, false); }
+    bool visit(cond_class *e)            { return in(e->pred, true) || in(e->then_exp, value) || in(e->else_exp, value); }
+    bool visit(loop_class *e)            { return in(e->pred, true) || in(e->body, true); }
+    bool visit(let_class *e)             { return in(e->init, is_unboxed_type(e->type_decl)) ||
+                                                  (e->identifier != name && in(e->body, value)); }
+    bool visit(plus_class *e)            { return operands(e->e1, e->e2); }
+    bool visit(sub_class *e)             { return operands(e->e1, e->e2); }
+    bool visit(mul_class *e)             { return operands(e->e1, e->e2); }
+    bool visit(divide_class *e)          { return operands(e->e1, e->e2); }
+    bool visit(lt_class *e)              { return operands(e->e1, e->e2); }
+    bool visit(leq_class *e)             { return operands(e->e1, e->e2); }
+    bool visit(eq_class *e)              { return in(e->e1, compares_values(e)) || in(e->e2, compares_values(e)); }
+    bool visit(neg_class *e)             { return in(e->e1, true); }
+    bool visit(comp_class *e)            { return in(e->e1, true); }
+    bool visit(isvoid_class *e)          { return in(e->e1, false); }
+    bool visit(int_const_class *e)       { return false; }
+    bool visit(bool_const_class *e)      { return false; }
+    bool visit(string_const_class *e)    { return false; }
+    bool visit(new__class *e)            { return false; }
+    bool visit(no_expr_class *e)         { return false; }
+    bool visit(object_class *e)          { return e->name == name && !value; }
+
+    // all but the last expression are coded for their effect, which reads
+    // a raw variable raw
+    bool visit(block_class *e) {
+        Expressions body = e->body;
+        for (int i = body->first(); body->more(i); i = body->next(i)) {
+            if (in(body->nth(i), body->more(body->next(i)) || value)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-void CgenClassTable::install_basic_classes()
+    bool visit(typcase_class *e) {
+        if (in(e->expr, false)) {
+            return true;
+        }
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            if (e->cases->nth(i)->get_name() != name && in(e->cases->nth(i)->get_expr(), false)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static bool read_boxed(Symbol name, Expression e, bool value)
 {
-    // The tree package uses these globals to annotate the classes built below.
-    //curr_lineno  = 0;
-    Symbol filename = stringtable.add_string("<basic class>");
+    BoxedRead r = { name, value };
+    return visit(e, r);
+}
 
-    //
-    // A few special class names are installed in the lookup table but not
-    // the class list.  Thus, these classes exist, but are not part of the
-    // inheritance hierarchy.
-    // No_class serves as the parent of Object and the other special classes.
-    // SELF_TYPE is the self class; it cannot be redefined or inherited.
-    // prim_slot is a class known to the code generator.
-    //
-    addid(No_class,
-            new CgenNode(class_(No_class,No_class,nil_Features(),filename),
-            Basic,this));
-    addid(SELF_TYPE,
-            new CgenNode(class_(SELF_TYPE,No_class,nil_Features(),filename),
-            Basic,this));
-    addid(prim_slot,
-            new CgenNode(class_(prim_slot,No_class,nil_Features(),filename),
-            Basic,this));
+//
+// May the code of e, coded for its raw value if "value" is set, call
+// anything, a method or the runtime?  A body for which the answer is no
+// is a leaf (see begin_frame).  Under -O only, and the answer is yes for
+// everything not known to be coded without a call: dispatch, unless it
+// is inlined or a tail call coded as a jump, new and case, boxing an Int, the write
+// barrier and equality_test, and reading a let variable that may be raw
+// and so be boxed.
+//
+static bool codes_call(Expression e, bool value, Environment &env);
 
-    //
-    // The Object class has no parent class. Its methods are
-    //        cool_abort() : Object    aborts the program
-    //        type_name() : Str        returns a string representation of class name
-    //        copy() : SELF_TYPE       returns a copy of the object
-    //
-    // There is no need for method bodies in the basic classes---these
-    // are already built in to the runtime system.
-    //
+struct CallCoder {
+    typedef bool result_type;
 
-    Class_ c_obj = class_(Object, No_class, append_Features(
-            append_Features(
-                single_Features(method(cool_abort, nil_Formals(), Object, no_expr())),
-                single_Features(method(type_name, nil_Formals(), Str, no_expr()))),
-                single_Features(method(copy, nil_Formals(), SELF_TYPE, no_expr()))),
-            filename);
+    bool value;
+    Environment &env;
 
-    install_class(new CgenNode(c_obj, Basic, this));
+    CallCoder(bool value, Environment &env) : value(value), env(env) { }
 
-    //
-    // The IO class inherits from Object. Its methods are
-    //        out_string(Str) : SELF_TYPE          writes a string to the output
-    //        out_int(Int) : SELF_TYPE               "    an int    "  "     "
-    //        in_string() : Str                    reads a string from the input
-    //        in_int() : Int                         "   an int     "  "     "
-    //
+    bool in(Expression e, bool v) {
+        return codes_call(e, v, env);
+    }
 
-    Class_ c_io = class_(IO, Object, append_Features(
-            append_Features(
-                append_Features(
-                    single_Features(method(out_string, single_Formals(formal(arg, Str)),
-                                SELF_TYPE, no_expr())),
-                    single_Features(method(out_int, single_Formals(formal(arg, Int)),
-                                SELF_TYPE, no_expr()))),
-                    single_Features(method(in_string, nil_Formals(), Str, no_expr()))),
-                single_Features(method(in_int, nil_Formals(), Int, no_expr()))),
-            filename);
+    bool any(Expressions es) {
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            if (in(es->nth(i), false)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-    install_class(new CgenNode(c_io, Basic, this));
+    bool operands(Expression e1, Expression e2) {
+        return in(e1, true) || in(e2, true);
+    }
 
-    //
-    // The Int class has no methods and only a single attribute, the
-    // "val" for the integer.
-    //
+    // an Int result is boxed unless coded for its value
+    bool arith(Expression e1, Expression e2) {
+        return !value || operands(e1, e2);
+    }
 
-    Class_ c_int = class_(Int, Object,
-             single_Features(attr(val, prim_slot, no_expr())), filename);
+    bool visit(assign_class *e)          { return cgen_Memmgr == GC_GENGC || in(e->expr, false); }
+    bool visit(static_dispatch_class *e) { return true; }
+    bool visit(dispatch_class *e)        { return any(e->actual) || in(e->expr, false) || dispatch_codes_call(e, env); }
+    bool visit(cond_class *e)            { return in(e->pred, false) || in(e->then_exp, false) || in(e->else_exp, false); }
+    bool visit(loop_class *e)            { return in(e->pred, false) || in(e->body, false); }
+    bool visit(block_class *e)           { return any(e->body); }
+    bool visit(let_class *e)             { return is_unboxed_type(e->type_decl) || in(e->init, false) || in(e->body, false); }
+    bool visit(plus_class *e)            { return arith(e->e1, e->e2); }
+    bool visit(sub_class *e)             { return arith(e->e1, e->e2); }
+    bool visit(mul_class *e)             { return arith(e->e1, e->e2); }
+    bool visit(divide_class *e)          { return arith(e->e1, e->e2); }
+    bool visit(neg_class *e)             { return !value || in(e->e1, true); }
+    bool visit(lt_class *e)              { return operands(e->e1, e->e2); }
+    bool visit(leq_class *e)             { return operands(e->e1, e->e2); }
+    bool visit(comp_class *e)            { return in(e->e1, true); }
+    bool visit(isvoid_class *e)          { return in(e->e1, false); }
+    bool visit(int_const_class *e)       { return e->fresh && !value; }
+    bool visit(bool_const_class *e)      { return false; }
+    bool visit(string_const_class *e)    { return false; }
+    bool visit(new__class *e)            { return true; }
+    bool visit(no_expr_class *e)         { return false; }
+    bool visit(object_class *e)          { return false; }  // let variables are ruled out above
+    bool visit(typcase_class *e)         { return true; }
+
+    bool visit(eq_class *e) {
+        if (compares_values(e)) {
+            return operands(e->e1, e->e2);
+        }
+        Symbol type = e->e1->get_type();
+        return type == Int || type == Str || type == Bool || in(e->e1, false) || in(e->e2, false);
+    }
+};
 
-    install_class(new CgenNode(c_int, Basic, this));
+static bool codes_call(Expression e, bool value, Environment &env)
+{
+    CallCoder coder(value, env);
+    return visit(e, coder);
+}
 
-    //
-    // Bool also has only the "val" slot.
-    //
+// k if e is the Int constant 2^k, or -1
+static int power_of_two(Expression e)
+{
+    int v;
+    if (!int_value(e, v) || v <= 0 || (v & (v - 1))) {
+        return -1;
+    }
+    int k = 0;
+    while (v > 1) {
+        v >>= 1;
+        k++;
+    }
+    return k;
+}
 
-    Class_ c_bool = class_(Bool, Object,
-            single_Features(attr(val, prim_slot, no_expr())),filename);
+// Evaluates the operands of a binary operator on raw values.  Leaves the
+// value of e2 in $a0 and returns the register that holds the value of e1.
+static char *code_operands(Expression e1, Expression e2, ostream &s, Environment &env)
+{
+    if (cgen_Memmgr == GC_NOGC) {
+        code_value(e1, s, env);
+        char *held = hold_acc(e2, s, env);
+        code_value(e2, s, env);
+        return release_held(held, e2, T1, s, env);
+    }
 
-    install_class(new CgenNode(c_bool, Basic, this));
+    if (!disable_reg_alloc && env.get_raw_temps_in_use() < NUM_RAW_TEMPS &&
+        !may_call(e2)) {
+        code_value(e1, s, env);
+        char *reg = raw_temp_regs[env.alloc_raw_temp()];
+        emit_move(reg, ACC, s);
+        code_value(e2, s, env);
+        env.free_raw_temp();
+        return reg;
+    }
 
-    //
-    // The class Str has a number of slots and operations:
-    //       val                                  ???
-    //       str_field                            the string itself
-    //       length() : Int                       length of the string
-    //       concat(arg: Str) : Str               string concatenation
-    //       substr(arg: Int, arg2: Int): Str     substring
-    //
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
+    code_value(e2, s, env);
+    char *left = release_held(held, e2, T1, s, env);
+    emit_fetch_int(T1, left, s);
+    return T1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// coding strings, ints, and booleans
+//
+// Cool has three kinds of constants: strings, ints, and booleans.
+// This section defines code generation for each type.
+//
+// All string constants are listed in the global "stringtable" and have
+// type StringEntry.  StringEntry methods are defined both for String
+// constant definitions and references.
+//
+// All integer constants are listed in the global "inttable" and have
+// type IntEntry.  IntEntry methods are defined for Int
+// constant definitions and references.
+//
+// Since there are only two Bool values, there is no need for a table.
+// The two booleans are represented by instances of the class BoolConst,
+// which defines the definition and reference methods for Bools.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Notes that the constant with index i is referred to; under -O only
+// those are coded (see code_constants).
+static void mark_used(std::vector<bool> &used, int i)
+{
+    if (i >= (int) used.size()) {
+        used.resize(i + 1, false);
+    }
+    used[i] = true;
+}
+
+//
+// Strings
+//
+void StringEntry::code_ref(ostream& s)
+{
+    mark_used(strings_used, index);
+    s << STRCONST_PREFIX << index;
+}
+
+//
+// Emit code for a constant String.
+// You should fill in the code naming the dispatch table.
+//
+
+void StringEntry::code_def(ostream& s, int stringclasstag)
+{
+    IntEntryP lensym = inttable.add_int(len);
+
+    // Add -1 eye catcher
+    s << WORD << "-1" << endl;
+
+    code_ref(s);
+    s << LABEL                                                          // label
+      << WORD << stringclasstag << endl                                 // tag
+      << WORD << (DEFAULT_OBJFIELDS + STRING_SLOTS + (len+4)/4) << endl // size
+      << WORD;
+
+    /***** Add dispatch information for class String ******/
+    s << Str << DISPTAB_SUFFIX;
+
+    s << endl;                                                  // dispatch table
+    s << WORD;
+    lensym->code_ref(s);
+    s << endl;                                                  // string length
+    emit_string_constant(s,str);                                // ascii string
+    s << ALIGN;                                                 // align to word
+}
+
+//
+// StrTable::code_string
+// Generate a string object definition for every string constant in the
+// stringtable.
+//
+void StrTable::code_string_table(ostream& s, int stringclasstag)
+{
+    for (List<StringEntry> *l = tbl; l; l = l->tl()) {
+        l->hd()->code_def(s,stringclasstag);
+    }
+}
+
+//
+// Ints
+//
+void IntEntry::code_ref(ostream &s)
+{
+    mark_used(ints_used, index);
+    s << INTCONST_PREFIX << index;
+}
+
+//
+// Emit code for a constant Integer.
+// You should fill in the code naming the dispatch table.
+//
+
+void IntEntry::code_def(ostream &s, int intclasstag)
+{
+    // Add -1 eye catcher
+    s << WORD << "-1" << endl;
+
+    code_ref(s);
+    s << LABEL                                            // label
+      << WORD << intclasstag << endl                      // class tag
+      << WORD << (DEFAULT_OBJFIELDS + INT_SLOTS) << endl  // object size
+      << WORD;
+
+    /***** Add dispatch information for class Int ******/
+    s << Int << DISPTAB_SUFFIX;
+
+    s << endl;                                          // dispatch table
+    s << WORD << str << endl;                           // integer value
+}
+
+
+//
+// IntTable::code_string_table
+// Generate an Int object definition for every Int constant in the
+// inttable.
+//
+void IntTable::code_string_table(ostream &s, int intclasstag)
+{
+    for (List<IntEntry> *l = tbl; l; l = l->tl()) {
+        l->hd()->code_def(s,intclasstag);
+    }
+}
+
+
+//
+// Bools
+//
+BoolConst::BoolConst(int i) : val(i) { assert(i == 0 || i == 1); }
+
+void BoolConst::code_ref(ostream& s) const
+{
+    s << BOOLCONST_PREFIX << val;
+}
+
+//
+// Emit code for a constant Bool.
+// You should fill in the code naming the dispatch table.
+//
+
+void BoolConst::code_def(ostream& s, int boolclasstag)
+{
+    // Add -1 eye catcher
+    s << WORD << "-1" << endl;
+
+    code_ref(s);
+    s << LABEL                                              // label
+      << WORD << boolclasstag << endl                       // class tag
+      << WORD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << endl   // object size
+      << WORD;
+
+    /***** Add dispatch information for class Bool ******/
+    s << Bool << DISPTAB_SUFFIX;
+
+    s << endl;                                            // dispatch table
+    s << WORD << val << endl;                             // value (0 or 1)
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CgenClassTable methods
+//
+//////////////////////////////////////////////////////////////////////////////
+
+//***************************************************
+//
+//  Emit code to start the .data segment and to
+//  declare the global names.
+//
+//***************************************************
+
+void CgenClassTable::code_global_data()
+{
+    Symbol main    = idtable.lookup_string(MAINNAME);
+    Symbol string  = idtable.lookup_string(STRINGNAME);
+    Symbol integer = idtable.lookup_string(INTNAME);
+    Symbol boolc   = idtable.lookup_string(BOOLNAME);
+
+    str << "\t.data\n" << ALIGN;
+    //
+    // The following global names must be defined first.
+    //
+    str << GLOBAL << CLASSNAMETAB << endl;
+    str << GLOBAL; emit_protobj_ref(main,str);    str << endl;
+    str << GLOBAL; emit_protobj_ref(integer,str); str << endl;
+    str << GLOBAL; emit_protobj_ref(string,str);  str << endl;
+    str << GLOBAL; falsebool.code_ref(str);  str << endl;
+    str << GLOBAL; truebool.code_ref(str);   str << endl;
+    str << GLOBAL << INTTAG << endl;
+    str << GLOBAL << BOOLTAG << endl;
+    str << GLOBAL << STRINGTAG << endl;
+
+    //
+    // We also need to know the tag of the Int, String, and Bool classes
+    // during code generation.
+    //
+    str << INTTAG << LABEL
+        << WORD << intclasstag << endl;
+    str << BOOLTAG << LABEL
+        << WORD << boolclasstag << endl;
+    str << STRINGTAG << LABEL
+        << WORD << stringclasstag << endl;
+}
+
+
+//***************************************************
+//
+//  Emit code to start the .text segment and to
+//  declare the global names.
+//
+//***************************************************
+
+void CgenClassTable::code_global_text()
+{
+    if (!cgen_optimize) {
+        code_heap_start();
+    }
+    str << "\t.text" << endl
+        << GLOBAL;
+    emit_init_ref(idtable.add_string("Main"), str);
+    str << endl << GLOBAL;
+    emit_init_ref(idtable.add_string("Int"),str);
+    str << endl << GLOBAL;
+    emit_init_ref(idtable.add_string("String"),str);
+    str << endl << GLOBAL;
+    emit_init_ref(idtable.add_string("Bool"),str);
+    str << endl << GLOBAL;
+    emit_method_ref(idtable.add_string("Main"), idtable.add_string("main"), str);
+    str << endl;
+}
+
+// The heap starts after the last of the data.
+void CgenClassTable::code_heap_start()
+{
+    str << GLOBAL << HEAP_START << endl
+        << HEAP_START << LABEL
+        << WORD << 0 << endl;
+}
+
+void CgenClassTable::code_bools(int boolclasstag)
+{
+    falsebool.code_def(str,boolclasstag);
+    truebool.code_def(str,boolclasstag);
+}
+
+void CgenClassTable::code_select_gc()
+{
+    //
+    // Generate GC choice constants (pointers to GC functions)
+    //
+    str << GLOBAL << "_MemMgr_INITIALIZER" << endl;
+    str << "_MemMgr_INITIALIZER:" << endl;
+    str << WORD << gc_init_names[cgen_Memmgr] << endl;
+    str << GLOBAL << "_MemMgr_COLLECTOR" << endl;
+    str << "_MemMgr_COLLECTOR:" << endl;
+    str << WORD << gc_collect_names[cgen_Memmgr] << endl;
+    str << GLOBAL << "_MemMgr_TEST" << endl;
+    str << "_MemMgr_TEST:" << endl;
+    str << WORD << (cgen_Memmgr_Test == GC_TEST) << endl;
+}
+
+
+//********************************************************
+//
+// Emit code to reserve space for and initialize all of
+// the constants.  Class names should have been added to
+// the string table (in the supplied code, is is done
+// during the construction of the inheritance graph), and
+// code for emitting string constants as a side effect adds
+// the string's length to the integer table.  The constants
+// are emmitted by running through the stringtable and inttable
+// and producing code for each entry.
+//
+// Under -O the constants are coded after the code, and only those it
+// refers to (see mark_used).  Strings come first, since coding one
+// refers to the Int of its length.
+//
+//********************************************************
+
+void CgenClassTable::code_constants()
+{
+    //
+    // Add constants that are required by the code generator.
+    //
+    stringtable.add_string("");
+    inttable.add_string("0");
+
+    if (!cgen_optimize) {
+        stringtable.code_string_table(str,stringclasstag);
+        inttable.code_string_table(str,intclasstag);
+    } else {
+        for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i)) {
+            if (i < (int) strings_used.size() && strings_used[i]) {
+                stringtable.lookup(i)->code_def(str,stringclasstag);
+            }
+        }
+        for (int i = inttable.first(); inttable.more(i); i = inttable.next(i)) {
+            if (i < (int) ints_used.size() && ints_used[i]) {
+                inttable.lookup(i)->code_def(str,intclasstag);
+            }
+        }
+    }
+    code_bools(boolclasstag);
+}
+
+int get_class_tag(Symbol name)
+{
+    unsigned int i = name->get_index();
+    return i < class_tags.size() ? class_tags[i] : -1;
+}
+
+Class_ get_class(Symbol name)
+{
+    return cls_ordered[get_class_tag(name)];
+}
+
+// the dispatch table offset of method name in class cls
+int get_method_slot(Symbol cls, Symbol name)
+{
+    return dispatch_tables[get_class_tag(cls)].slot(name);
+}
+
+static bool pre_order_less(Class_ a, Class_ b)
+{
+    return class_hierarchy.pre(a->get_name()) < class_hierarchy.pre(b->get_name());
+}
+
+CgenClassTable::CgenClassTable(Classes classes, ostream& s) : nds(NULL) , str(s)
+{
+    enterscope();
+    if (cgen_debug) {
+        cout << "Building CgenClassTable" << endl;
+    }
+
+    install_basic_classes();
+
+    // push the rest of the classes in cls_ordered
+    for (int i = classes->first(); classes->more(i); i = classes->next(i)) {
+        cls_ordered.push_back(classes->nth(i));
+    }
+
+    // and number them in pre-order
+    for (std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        class_hierarchy.add_class(cls_ordered[i]->get_name(), cls_ordered[i]->get_parent());
+    }
+    class_hierarchy.build();
+    std::sort(cls_ordered.begin(), cls_ordered.end(), pre_order_less);
+
+    for (std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        unsigned int index = cls_ordered[i]->get_name()->get_index();
+        if (index >= class_tags.size()) {
+            class_tags.resize(index + 1, -1);
+        }
+        class_tags[index] = i;
+    }
+
+    // a subclass has a higher tag than its parent
+    last_subclass_tags.resize(cls_ordered.size());
+    for (int i = cls_ordered.size() - 1; i >= 0; i--) {
+        last_subclass_tags[i] = std::max(last_subclass_tags[i], i);
+        if (cls_ordered[i]->get_name() != Object) {
+            int parent = get_class_tag(cls_ordered[i]->get_parent());
+            last_subclass_tags[parent] = std::max(last_subclass_tags[parent], last_subclass_tags[i]);
+        }
+    }
+
+    intclasstag = get_class_tag(Int);
+    boolclasstag = get_class_tag(Bool);
+    stringclasstag = get_class_tag(Str);
+
+    install_classes(classes);
+    build_inheritance_tree();
+    build_layouts();
+
+    code();
+    exitscope();
+}
+
+void CgenClassTable::install_basic_classes()
+{
+    // The tree package uses these globals to annotate the classes built below.
+    //curr_lineno  = 0;
+    Symbol filename = stringtable.add_string("<basic class>");
+
+    //
+    // A few special class names are installed in the lookup table but not
+    // the class list.  Thus, these classes exist, but are not part of the
+    // inheritance hierarchy.
+    // No_class serves as the parent of Object and the other special classes.
+    // SELF_TYPE is the self class; it cannot be redefined or inherited.
+    // prim_slot is a class known to the code generator.
+    //
+    addid(No_class,
+            new CgenNode(class_(No_class,No_class,nil_Features(),filename),
+            Basic,this));
+    addid(SELF_TYPE,
+            new CgenNode(class_(SELF_TYPE,No_class,nil_Features(),filename),
+            Basic,this));
+    addid(prim_slot,
+            new CgenNode(class_(prim_slot,No_class,nil_Features(),filename),
+            Basic,this));
+
+    //
+    // The Object class has no parent class. Its methods are
+    //        cool_abort() : Object    aborts the program
+    //        type_name() : Str        returns a string representation of class name
+    //        copy() : SELF_TYPE       returns a copy of the object
+    //
+    // There is no need for method bodies in the basic classes---these
+    // are already built in to the runtime system.
+    //
+
+    Class_ c_obj = class_(Object, No_class, append_Features(
+            append_Features(
+                single_Features(method(cool_abort, nil_Formals(), Object, no_expr())),
+                single_Features(method(type_name, nil_Formals(), Str, no_expr()))),
+                single_Features(method(copy, nil_Formals(), SELF_TYPE, no_expr()))),
+            filename);
+
+    install_class(new CgenNode(c_obj, Basic, this));
+
+    //
+    // The IO class inherits from Object. Its methods are
+    //        out_string(Str) : SELF_TYPE          writes a string to the output
+    //        out_int(Int) : SELF_TYPE               "    an int    "  "     "
+    //        in_string() : Str                    reads a string from the input
+    //        in_int() : Int                         "   an int     "  "     "
+    //
+
+    Class_ c_io = class_(IO, Object, append_Features(
+            append_Features(
+                append_Features(
+                    single_Features(method(out_string, single_Formals(formal(arg, Str)),
+                                SELF_TYPE, no_expr())),
+                    single_Features(method(out_int, single_Formals(formal(arg, Int)),
+                                SELF_TYPE, no_expr()))),
+                    single_Features(method(in_string, nil_Formals(), Str, no_expr()))),
+                single_Features(method(in_int, nil_Formals(), Int, no_expr()))),
+            filename);
+
+    install_class(new CgenNode(c_io, Basic, this));
+
+    //
+    // The Int class has no methods and only a single attribute, the
+    // "val" for the integer.
+    //
+
+    Class_ c_int = class_(Int, Object,
+             single_Features(attr(val, prim_slot, no_expr())), filename);
+
+    install_class(new CgenNode(c_int, Basic, this));
+
+    //
+    // Bool also has only the "val" slot.
+    //
+
+    Class_ c_bool = class_(Bool, Object,
+            single_Features(attr(val, prim_slot, no_expr())),filename);
+
+    install_class(new CgenNode(c_bool, Basic, this));
+
+    //
+    // The class Str has a number of slots and operations:
+    //       val                                  ???
+    //       str_field                            the string itself
+    //       length() : Int                       length of the string
+    //       concat(arg: Str) : Str               string concatenation
+    //       substr(arg: Int, arg2: Int): Str     substring
+    //
+
+    Class_ c_str = class_(Str, Object,
+        append_Features(
+            append_Features(
+                append_Features(
+                    append_Features(
+                        single_Features(attr(val, Int, no_expr())),
+                        single_Features(attr(str_field, prim_slot, no_expr()))),
+                    single_Features(method(length, nil_Formals(), Int, no_expr()))),
+                single_Features(method(concat, single_Formals(formal(arg, Str)), Str, no_expr()))),
+            single_Features(method(substr,
+                append_Formals(single_Formals(formal(arg, Int)),
+                    single_Formals(formal(arg2, Int))), Str, no_expr()))),
+        filename);
+
+    install_class(new CgenNode(c_str, Basic, this));
+
+    // order of insertion assigns class tag starting from 0
+    cls_ordered.push_back(c_obj);
+    cls_ordered.push_back(c_io);
+    cls_ordered.push_back(c_int);
+    cls_ordered.push_back(c_bool);
+    cls_ordered.push_back(c_str);
+}
+
+// CgenClassTable::install_class
+// CgenClassTable::install_classes
+//
+// install_classes enters a list of classes in the symbol table.
+//
+void CgenClassTable::install_class(CgenNodeP nd)
+{
+    Symbol name = nd->get_name();
+
+    if (probe(name)) {
+        return;
+    }
+
+    // The class name is legal, so add it to the list of classes
+    // and the symbol table.
+    nds = new List<CgenNode>(nd,nds);
+    addid(name,nd);
+}
+
+void CgenClassTable::install_classes(Classes cs)
+{
+    for(int i = cs->first(); cs->more(i); i = cs->next(i)) {
+        install_class(new CgenNode(cs->nth(i),NotBasic,this));
+    }
+}
+
+//
+// CgenClassTable::build_inheritance_tree
+//
+void CgenClassTable::build_inheritance_tree()
+{
+    for(List<CgenNode> *l = nds; l; l = l->tl()) {
+        set_relations(l->hd());
+    }
+}
+
+//
+// CgenClassTable::set_relations
+//
+// Takes a CgenNode and locates its, and its parent's, inheritance nodes
+// via the class table.  Parent and child pointers are added as appropriate.
+//
+void CgenClassTable::set_relations(CgenNodeP nd)
+{
+    CgenNode *parent_node = probe(nd->get_parent());
+    nd->set_parentnd(parent_node);
+    parent_node->add_child(nd);
+}
+
+void CgenNode::add_child(CgenNodeP n)
+{
+    children = new List<CgenNode>(n,children);
+}
+
+void CgenNode::set_parentnd(CgenNodeP p)
+{
+    assert(parentnd == NULL);
+    assert(p != NULL);
+    parentnd = p;
+}
+
+//
+// Reachability.  Under -O only what the program can run is coded: the
+// methods that may be called, starting from Main.main, the initializers
+// of the classes that may be instantiated and of the classes they
+// inherit from, and the prototypes and dispatch tables those need.  The
+// runtime makes Int, String, Bool and Main objects.
+//
+// A dispatch on an object of static type T may call the method of any
+// instantiated class that inherits from T, and that of T itself, which a
+// direct call (see overridden_slots) calls even if no object of a class
+// inheriting from T is ever made.  A class becomes instantiated when a
+// reached body has new on it; new SELF_TYPE makes an object of the class
+// of self, which is instantiated already.  So the calls seen are kept,
+// and each class instantiated later is checked against them.
+//
+struct Reacher {
+    typedef void result_type;
+
+    Class_ cls;     // whose code is walked
+    std::vector<std::pair<int, Symbol> > calls;           // (tag of T, name)
+    std::vector<std::pair<Class_, Expression> > pending;  // code to walk
+
+    // the method called through the table of class tag for name
+    void reach_method(int tag, Symbol name) {
+        const MethodTable::Slot &target = dispatch_tables[tag].nth(dispatch_tables[tag].slot(name));
+        if (reached_methods.insert(target.second).second) {
+            pending.push_back(std::make_pair(target.first, target.second->expr));
+        }
+    }
+
+    void reach_init(int tag) {
+        if (reached_inits[tag]) {
+            return;
+        }
+        reached_inits[tag] = true;
+        Class_ c = cls_ordered[tag];
+        Features features = c->get_features();
+        for (int i = features->first(); features->more(i); i = features->next(i)) {
+            attr_class *at = as_attr(features->nth(i));
+            if (at) {
+                pending.push_back(std::make_pair(c, at->get_init()));
+            }
+        }
+        if (c->get_name() != Object) {
+            reach_init(get_class_tag(c->get_parent()));
+        }
+    }
+
+    void instantiate(int tag) {
+        if (instantiated[tag]) {
+            return;
+        }
+        instantiated[tag] = true;
+        reach_init(tag);
+        for (auto c : calls) {
+            if (c.first <= tag && tag <= last_subclass_tags[c.first]) {
+                reach_method(tag, c.second);
+            }
+        }
+    }
+
+    void call(int tag, Symbol name) {
+        calls.push_back(std::make_pair(tag, name));
+        reach_method(tag, name);
+        for (int d = tag; d <= last_subclass_tags[tag]; d++) {
+            if (instantiated[d]) {
+                reach_method(d, name);
+            }
+        }
+    }
+
+    void walk(Expression e)  { ::visit(e, *this); }
+
+    void walk(Expressions es) {
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            walk(es->nth(i));
+        }
+    }
+
+    void visit(static_dispatch_class *e) {
+        walk(e->expr);
+        walk(e->actual);
+        int tag = get_class_tag(e->type_name);
+        read_tables[tag] = true;
+        reach_method(tag, e->name);
+    }
+
+    void visit(dispatch_class *e) {
+        walk(e->expr);
+        walk(e->actual);
+        Symbol type = e->expr->get_type();
+        call(get_class_tag(type == SELF_TYPE ? cls->get_name() : type), e->name);
+    }
+
+    void visit(new__class *e) {
+        if (e->type_name != SELF_TYPE) {
+            instantiate(get_class_tag(e->type_name));
+        }
+    }
+
+    void visit(assign_class *e)          { walk(e->expr); }
+    void visit(cond_class *e)            { walk(e->pred); walk(e->then_exp); walk(e->else_exp); }
+    void visit(loop_class *e)            { walk(e->pred); walk(e->body); }
+    void visit(block_class *e)           { walk(e->body); }
+    void visit(let_class *e)             { walk(e->init); walk(e->body); }
+    void visit(plus_class *e)            { walk(e->e1); walk(e->e2); }
+    void visit(sub_class *e)             { walk(e->e1); walk(e->e2); }
+    void visit(mul_class *e)             { walk(e->e1); walk(e->e2); }
+    void visit(divide_class *e)          { walk(e->e1); walk(e->e2); }
+    void visit(lt_class *e)              { walk(e->e1); walk(e->e2); }
+    void visit(eq_class *e)              { walk(e->e1); walk(e->e2); }
+    void visit(leq_class *e)             { walk(e->e1); walk(e->e2); }
+    void visit(neg_class *e)             { walk(e->e1); }
+    void visit(comp_class *e)            { walk(e->e1); }
+    void visit(isvoid_class *e)          { walk(e->e1); }
+    void visit(int_const_class *e)       { }
+    void visit(bool_const_class *e)      { }
+    void visit(string_const_class *e)    { }
+    void visit(no_expr_class *e)         { }
+    void visit(object_class *e)          { }
+
+    void visit(typcase_class *e) {
+        walk(e->expr);
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            walk(e->cases->nth(i)->get_expr());
+        }
+    }
+};
+
+static void find_reachable()
+{
+    instantiated.assign(cls_ordered.size(), false);
+    reached_inits.assign(cls_ordered.size(), false);
+    read_tables.assign(cls_ordered.size(), false);
+
+    Reacher reacher;
+    reacher.instantiate(get_class_tag(Int));
+    reacher.instantiate(get_class_tag(Str));
+    reacher.instantiate(get_class_tag(Bool));
+    reacher.instantiate(get_class_tag(Main));
+    reacher.reach_method(get_class_tag(Main), main_meth);
+
+    while (!reacher.pending.empty()) {
+        std::pair<Class_, Expression> code = reacher.pending.back();
+        reacher.pending.pop_back();
+        reacher.cls = code.first;
+        reacher.walk(code.second);
+    }
+}
+
+static void print_reachability_stats(ostream &out)
+{
+    int methods = 0;
+    for (auto cls : cls_ordered) {
+        Features features = cls->get_features();
+        for (int i = features->first(); features->more(i); i = features->next(i)) {
+            methods += as_method(features->nth(i)) != NULL;
+        }
+    }
+    out << "reachable: " << reached_methods.size() << " of " << methods << " methods, "
+        << std::count(instantiated.begin(), instantiated.end(), true) << " of "
+        << cls_ordered.size() << " classes instantiated, "
+        << std::count(reached_inits.begin(), reached_inits.end(), true) << " initializers" << endl;
+}
+
+// Whether class tag, its initializer, its dispatch table and method m are
+// coded; without -O they all are.
+static bool is_instantiated(int tag)
+{
+    return !cgen_optimize || instantiated[tag];
+}
+
+static bool is_init_reached(int tag)
+{
+    return !cgen_optimize || reached_inits[tag];
+}
+
+static bool is_table_read(int tag)
+{
+    return !cgen_optimize || instantiated[tag] || read_tables[tag];
+}
+
+static bool is_method_reached(method_class *m)
+{
+    return !cgen_optimize || reached_methods.count(m);
+}
+
+void CgenClassTable::code_class_name_tab()
+{
+    str << CLASSNAMETAB << LABEL;
+
+    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        str << WORD;
+        if (is_instantiated(i)) {
+            stringtable.lookup_string(cls_ordered[i]->get_name()->get_string())->code_ref(str);
+        } else {
+            str << "0";
+        }
+        str << endl;
+    }
+}
+
+/*
+ * Prints a table which at index (class_tag) * 4 contains the tag of the
+ * corresponding parent class tag.
+ */
+void CgenClassTable::code_class_parent_tab()
+{
+    str << CLASSPARENTTAB << LABEL;
+    for(auto it = cls_ordered.begin(); it != cls_ordered.end(); it++) {
+        if ((*it)->get_name() == Object) {
+            str << WORD << INVALID_CLASSTAG << endl;
+        } else {
+            str << WORD << get_class_tag((*it)->get_parent()) << endl;
+        }
+    }
+}
+
+void CgenClassTable::code_class_obj_tab()
+{
+    str << CLASSOBJTAB << LABEL;
+    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        if (is_instantiated(i)) {
+            str << WORD << cls_ordered[i]->get_name() << PROTOBJ_SUFFIX << endl;
+            str << WORD << cls_ordered[i]->get_name() << CLASSINIT_SUFFIX << endl;
+        } else {
+            str << WORD << "0" << endl;
+            str << WORD << "0" << endl;
+        }
+    }
+}
+
+/*
+ * Lays out every class's attributes and dispatch table.  Classes are
+ * visited in tag order, parents first, so each one starts from a copy of
+ * its parent's layout and only adds its own features.
+ */
+void CgenClassTable::build_layouts()
+{
+    dispatch_tables.assign(cls_ordered.size(), MethodTable());
+
+    for (auto cls : cls_ordered) {
+        int tag = get_class_tag(cls->get_name());
+        if (cls->get_name() != Object) {
+            Class_ parent = get_class(cls->get_parent());
+            cls->all_attrs = parent->all_attrs;
+            dispatch_tables[tag] = dispatch_tables[get_class_tag(parent->get_name())];
+        }
+
+        Features features = cls->get_features();
+        for (int i = features->first(); features->more(i); i = features->next(i)) {
+            Feature f = features->nth(i);
+            if (attr_class *attr = as_attr(f)) {
+                cls->all_attrs.push_back(attr);
+            } else {
+                dispatch_tables[tag].add(cls, as_method(f));
+            }
+        }
+    }
+
+    // Then children first, so that each class is reached after every
+    // class that inherits from it.  A slot is overridden in a class if a
+    // child puts another method in it or overrides it further down.
+    overridden_slots.assign(cls_ordered.size(), std::vector<bool>());
+    for (auto cls : cls_ordered) {
+        int tag = get_class_tag(cls->get_name());
+        overridden_slots[tag].assign(dispatch_tables[tag].size(), false);
+    }
+    for (auto it = cls_ordered.rbegin(); it != cls_ordered.rend(); it++) {
+        if ((*it)->get_name() == Object) {
+            continue;
+        }
+        int tag = get_class_tag((*it)->get_name());
+        int parent = get_class_tag((*it)->get_parent());
+        for (int j = 0; j < dispatch_tables[parent].size(); j++) {
+            if (overridden_slots[tag][j] ||
+                dispatch_tables[tag].nth(j).second != dispatch_tables[parent].nth(j).second) {
+                overridden_slots[parent][j] = true;
+            }
+        }
+    }
+}
+
+void CgenClassTable::code_dispatch_tables()
+{
+    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        const MethodTable &methods = dispatch_tables[i];
+        if (!is_table_read(i)) {
+            continue;
+        }
+        str << cls_ordered[i]->get_name() << DISPTAB_SUFFIX << LABEL;
+
+        for (int j = 0; j < methods.size(); j++) {
+            if (is_method_reached(methods.nth(j).second)) {
+                str << WORD << methods.nth(j).first->get_name() << "." << methods.nth(j).second->get_name() << endl;
+            } else {
+                str << WORD << "0" << endl;
+            }
+        }
+    }
+}
+
+void CgenClassTable::code_prototypes()
+{
+    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        Class_ cls = cls_ordered[i];
+        if (!is_instantiated(i)) {
+            continue;
+        }
+
+        str << WORD << "-1" << endl;
+        str << cls->get_name() << PROTOBJ_SUFFIX << LABEL;
+        str << WORD << i << endl; // class tag
+        str << WORD << DEFAULT_OBJFIELDS + cls->all_attrs.size() << endl; // object size
+        str << WORD << cls->get_name() << DISPTAB_SUFFIX << endl;
+
+        for (auto attr : cls->all_attrs) {
+            Symbol type = attr->get_type_decl();
+            str << WORD;
+            if (type == Int) {
+                inttable.lookup_string("0")->code_ref(str);
+            } else if (type == Bool) {
+                falsebool.code_ref(str);
+            } else if (type == Str) {
+                stringtable.lookup_string("")->code_ref(str);
+            } else {
+                str << "0";
+            }
+            str << endl;
+        }
+    }
+}
+
+//
+// Under -O an initializer does not call its parent's if that one does
+// nothing, which is true of one with no attribute initializers whose own
+// parent does nothing.  Such an initializer needs no frame; it returns
+// self, which it is passed in $a0.  Parents come before their children
+// in cls_ordered.
+//
+void CgenClassTable::code_initializers()
+{
+    std::unordered_map<Symbol, bool> inits_something;
+    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        Class_ cls = cls_ordered[i];
+        if (!is_init_reached(i)) {
+            continue;
+        }
+        AsmStream buffer(METHOD_BUFFER_SIZE);
+        ostream &str = method_stream(buffer, this->str);
+
+        str << cls->get_name() << CLASSINIT_SUFFIX << LABEL;
+
+        Environment env;
+        env.set_cls(cls);
+        for (auto attr : cls->all_attrs) {
+            env.add_cls_attr(attr);
+        }
+
+        bool parent_inits = cls->get_name() != Object &&
+                            (!cgen_optimize || inits_something[cls->get_parent()]);
+        Features features = cls->get_features();
+        int needed = 0;
+        bool leaf = !parent_inits;
+        for (int i = features->first(); features->more(i); i = features->next(i)) {
+            attr_class *at = as_attr(features->nth(i));
+            if (at && !at->get_init()->is_empty()) {
+                needed = std::max(needed, temps_needed(at->get_init()));
+                leaf = leaf && cgen_Memmgr != GC_GENGC && !codes_call(at->get_init(), false, env);
+            }
+        }
+
+        AsmStream body_buffer(METHOD_BUFFER_SIZE);
+        ostream &body = begin_frame(needed, leaf, body_buffer, str, env);
+
+        if (parent_inits) {
+            // initialize parent class first
+            emit_jal((char *) (std::string(cls->get_parent()->get_string()) + CLASSINIT_SUFFIX).c_str(), body);
+        }
+
+        bool attrs_init = false;
+        for (int i = features->first(); features->more(i); i = features->next(i)) {
+            attr_class *at = as_attr(features->nth(i));
+
+            if (at && !at->get_init()->is_empty()) {
+                at->get_init()->code(body, env);
+                int offset = DEFAULT_OBJFIELDS + env.get_cls_attr_pos(at->get_name());
+                emit_store(ACC, offset, env.use_self(), body);
+                if (cgen_Memmgr == GC_GENGC) {
+                    // a collection during the initializer may have
+                    // moved the object to the old area
+                    emit_addiu(A1, env.use_self(), 4 * offset, body);
+                    emit_gc_assign(body);
+                }
+                attrs_init = true;
+            }
+        }
+        inits_something[cls->get_name()] = parent_inits || attrs_init;
+
+        if (!cgen_optimize || attrs_init) {
+            emit_move(ACC, env.use_self(), body);
+        }
+        Frame frame = end_frame(needed, body_buffer, str, env);
+        emit_epilogue(frame, 0, str);
+
+        emit_return(str);
+        code_abort_calls(str);
+        end_method(buffer, this->str);
+    }
+}
+
+void CgenClassTable::code_methods()
+{
+    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
+        Class_ cls = cls_ordered[i];
+        Symbol name = cls->get_name();
+
+        if (!is_basic_class(name)) {
+            Environment env;
+            env.set_cls(cls);
+            for (auto attr : cls->all_attrs) {
+                env.add_cls_attr(attr);
+            }
+
+            Features features = cls->get_features();
+
+            for (int i = features->first(); features->more(i); i = features->next(i)) {
+                method_class *method = as_method(features->nth(i));
+                if (method && is_method_reached(method)) {
+                    method->code(str, env);
+                }
+            }
+        }
+    }
+}
+
+void CgenClassTable::code()
+{
+    if (cgen_optimize) {
+        find_reachable();
+        // the code refers to these before code_constants adds them
+        stringtable.add_string("");
+        inttable.add_string("0");
+    }
+
+    if (cgen_debug) cout << "coding global data" << endl;
+    code_global_data();
+
+    if (cgen_debug) cout << "choosing gc" << endl;
+    code_select_gc();
+
+    if (!cgen_optimize) {
+        if (cgen_debug) cout << "coding constants" << endl;
+        code_constants();
+    }
+
+    //                 Add your code to emit
+    //                   - prototype objects
+    //                   - class_nameTab
+    //                   - dispatch tables
+    //
+
+    code_class_name_tab();
+    code_class_parent_tab();
+    code_class_obj_tab();
+    code_dispatch_tables();
+    code_prototypes();
+
+    //if (cgen_debug) cout << "coding global text" << endl;
+    code_global_text();
+
+    //                 Add your code to emit
+    //                   - object initializer
+    //                   - the class methods
+    //                   - etc...
+
+    code_initializers();
+    code_methods();
+    code_void_dispatch_stubs();
+
+    if (cgen_optimize) {
+        if (cgen_debug) cout << "coding constants" << endl;
+        str << "\t.data\n" << ALIGN;
+        code_constants();
+        code_heap_start();
+    }
+}
+
+
+CgenNodeP CgenClassTable::root()
+{
+   return probe(Object);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// CgenNode methods
+//
+///////////////////////////////////////////////////////////////////////
+
+CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) :
+   class__class((const class__class &) *nd),
+   parentnd(NULL),
+   children(NULL),
+   basic_status(bstatus)
+{
+    stringtable.add_string(name->get_string());          // Add class name to string table
+}
+
+
+//******************************************************************
+//
+//   Fill in the following methods to produce code for the
+//   appropriate expression.  You may add or remove parameters
+//   as you wish, but if you do, remember to change the parameters
+//   of the declarations in `cool-tree.h'  Sample code for
+//   constant integers, strings, and booleans are provided.
+//
+//*****************************************************************
+//
+void method_class::code(ostream &out, Environment &env)
+{
+    AsmStream buffer(METHOD_BUFFER_SIZE);
+    ostream &s = method_stream(buffer, out);
+
+    emit_method_ref(env.get_cls()->get_name(), name, s);
+    s << LABEL;
+
+    for(int i = formals->first(); formals->more(i); i = formals->next(i)) {
+        env.add_mth_arg(formals->nth(i));
+    }
+
+    env.set_mth(this);
+    mark_tail_calls(expr);
+
+    AsmStream body_buffer(METHOD_BUFFER_SIZE);
+    ostream &body = begin_frame(temps_needed(expr), !codes_call(expr, false, env), body_buffer, s, env);
+    expr->code(body, env);
+    Frame frame = end_frame(temps_needed(expr), body_buffer, s, env);
+
+    emit_epilogue(frame, env.get_mth_args_size(), s);
+
+    s << RET << "\n";
+    code_tail_jumps(frame, env.get_mth_args_size(), s);
+    code_abort_calls(s);
+    env.clear_mth_args();
+    env.set_mth(NULL);
+    end_method(buffer, out);
+}
+
+// Assigns the raw value of expr to a raw let variable and leaves the
+// value in $a0.
+static void code_raw_assign(assign_class *e, ostream &s, Environment &env)
+{
+    code_value(e->expr, s, env);
+
+    char *reg = env.get_let_var_reg(e->name);
+    int slot = env.get_let_var_slot(e->name);
+    if (reg) {
+        emit_move(reg, ACC, s);
+    } else if (slot >= 0) {
+        emit_store(ACC, slot_offset(slot), env.use_fp(), s);
+    } else {
+        emit_store(ACC, env.get_let_var_pos_rev(e->name) + 1, SP, s);
+    }
+}
+
+void assign_class::code(ostream &s, Environment &env) {
+    if (env.is_raw_let_var(name)) {
+        code_raw_assign(this, s, env);
+        emit_box(env.get_raw_let_var_type(name), s);
+        return;
+    }
+
+    expr->code(s, env);
+    int pos, offset;
+
+    char *reg = env.get_let_var_reg(name);
+    if (reg) {
+        emit_move(reg, ACC, s);
+        return;
+    }
+
+    pos = env.get_let_var_slot(name);
+    if (pos != -1) {
+        offset = slot_offset(pos);
+        emit_store(ACC, offset, env.use_fp(), s);
+
+        if (cgen_Memmgr == GC_GENGC) {
+            emit_addiu(A1, env.use_fp(), 4 * offset, s);
+            emit_gc_assign(s);
+        }
+        return;
+    }
+
+    pos = env.get_let_var_pos_rev(name);
+    if (pos != -1) {
+        offset = pos + 1;
+        emit_store(ACC, offset, SP, s);
+
+        if (cgen_Memmgr == GC_GENGC) {
+            emit_addiu(A1, SP, 4 * offset, s);
+            emit_gc_assign(s);
+        }
+        return;
+    }
+
+    pos = env.get_arg_pos(name);
+    if (pos != -1) {
+        offset = 2 + env.get_mth_args_size() - pos;
+        emit_store(ACC, offset, env.use_fp(), s);
+
+        if (cgen_Memmgr == GC_GENGC) {
+            emit_addiu(A1, env.use_fp(), 4 * offset, s);
+            emit_gc_assign(s);
+        }
+        return;
+    }
+
+    pos = env.get_cls_attr_pos(name);
+    if (pos != -1) {
+        offset = DEFAULT_OBJFIELDS + pos;
+        emit_store(ACC, offset, env.use_self(), s);
+
+        if (cgen_Memmgr == GC_GENGC) {
+            emit_addiu(A1, env.use_self(), 4 * offset, s);
+            emit_gc_assign(s);
+        }
+        return;
+    }
+}
+
+void static_dispatch_class::code(ostream &s, Environment &env) {
+    int num_params = 0;
+
+    for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
+        actual->nth(i)->code(s, env);
+        emit_push(ACC, s);
+        env.push_stack_symbol(No_type);
+
+        num_params++;
+    }
+
+    // $a0 = expr_obj
+    expr->code(s, env);
 
-    Class_ c_str = class_(Str, Object,
-        append_Features(
-            append_Features(
-                append_Features(
-                    append_Features(
-                        single_Features(attr(val, Int, no_expr())),
-                        single_Features(attr(str_field, prim_slot, no_expr()))),
-                    single_Features(method(length, nil_Formals(), Int, no_expr()))),
-                single_Features(method(concat, single_Formals(formal(arg, Str)), Str, no_expr()))),
-            single_Features(method(substr,
-                append_Formals(single_Formals(formal(arg, Int)),
-                    single_Formals(formal(arg2, Int))), Str, no_expr()))),
-        filename);
+    // catch dispatch on void
+    code_void_check(expr, get_line_number(), s, env);
 
-    install_class(new CgenNode(c_str, Basic, this));
+    // $t1 = type_name_dispatch_pointer
+    emit_load_address(T1, (char *) (std::string(type_name->get_string()) + DISPTAB_SUFFIX).c_str(), s);
 
-    // order of insertion assigns class tag starting from 0
-    cls_ordered.push_back(c_obj);
-    cls_ordered.push_back(c_io);
-    cls_ordered.push_back(c_int);
-    cls_ordered.push_back(c_bool);
-    cls_ordered.push_back(c_str);
+    // $t1 += offset_to_proper_func
+    emit_load(T1, get_method_slot(type_name, name), T1, s);
+    // set $ra to next instruction and jump to $t1
+    emit_jalr(T1, s);
 
-    class_map.insert(std::make_pair(Object, c_obj));
-    class_map.insert(std::make_pair(IO, c_io));
-    class_map.insert(std::make_pair(Int, c_int));
-    class_map.insert(std::make_pair(Bool, c_bool));
-    class_map.insert(std::make_pair(Str, c_str));
+    for (int i = 0; i < num_params; i++) {
+        // this simply removes the symbols from the vector
+        // the callee is responsible for actually increasing the $sp
+        env.pop_stack_symbol();
+    }
 }
 
-// CgenClassTable::install_class
-// CgenClassTable::install_classes
-//
-// install_classes enters a list of classes in the symbol table.
-//
-void CgenClassTable::install_class(CgenNodeP nd)
-{
-    Symbol name = nd->get_name();
+void dispatch_class::code(ostream &s, Environment &env) {
+    int num_params = 0;
 
-    if (probe(name)) {
-        return;
+    for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
+        actual->nth(i)->code(s, env);
+        emit_push(ACC, s);
+        env.push_stack_symbol(No_type);
+
+        num_params++;
     }
 
-    // The class name is legal, so add it to the list of classes
-    // and the symbol table.
-    nds = new List<CgenNode>(nd,nds);
-    addid(name,nd);
-}
+    // $a0 = expr_obj
+    expr->code(s, env);
 
-void CgenClassTable::install_classes(Classes cs)
-{
-    for(int i = cs->first(); cs->more(i); i = cs->next(i)) {
-        install_class(new CgenNode(cs->nth(i),NotBasic,this));
+    // catch dispatch on void
+    code_void_check(expr, get_line_number(), s, env);
+
+    Symbol type = expr->get_type();
+    if (type == SELF_TYPE) {
+        type = env.get_cls()->get_name();
+    }
+    int tag = get_class_tag(type);
+    int slot = get_method_slot(type, name);
+
+    dispatches++;
+    if (cgen_optimize && !overridden_slots[tag][slot]) {
+        // no class the object can be of overrides the method
+        const MethodTable::Slot &target = dispatch_tables[tag].nth(slot);
+        // a method that calls itself last loops instead of being inlined
+        bool coded = target.second == env.get_mth() &&
+                     code_tail_call(this, target.first, target.second, num_params, s, env);
+        coded = coded || code_inline(this, target.first, target.second, num_params, s, env) ||
+                code_tail_call(this, target.first, target.second, num_params, s, env);
+        if (!coded) {
+            emit_method_call(target.first->get_name(), name, s);
+        }
+        direct_dispatches++;
+    } else {
+        // $t1 = expr_obj.dispatch_pointer
+        emit_load(T1, 2, ACC, s);
+
+        // $t1 += offset_to_proper_func
+        emit_load(T1, slot, T1, s);
+        // set $ra to next instruction and jump to $t1
+        emit_jalr(T1, s);
     }
-}
 
-//
-// CgenClassTable::build_inheritance_tree
-//
-void CgenClassTable::build_inheritance_tree()
-{
-    for(List<CgenNode> *l = nds; l; l = l->tl()) {
-        set_relations(l->hd());
+    for (int i = 0; i < num_params; i++) {
+        // this simply removes the symbols from the vector
+        // the callee is responsible for actually increasing the $sp
+        env.pop_stack_symbol();
     }
 }
 
-//
-// CgenClassTable::set_relations
-//
-// Takes a CgenNode and locates its, and its parent's, inheritance nodes
-// via the class table.  Parent and child pointers are added as appropriate.
-//
-void CgenClassTable::set_relations(CgenNodeP nd)
+// Evaluates a predicate and returns the register that holds its value,
+// 0 or 1.
+static char *code_pred(Expression pred, ostream &s, Environment &env)
 {
-    CgenNode *parent_node = probe(nd->get_parent());
-    nd->set_parentnd(parent_node);
-    parent_node->add_child(nd);
-}
+    if (unboxing() && has_raw_code(pred, env)) {
+        code_value(pred, s, env);
+        return ACC;
+    }
 
-void CgenNode::add_child(CgenNodeP n)
-{
-    children = new List<CgenNode>(n,children);
+    pred->code(s, env);
+    emit_fetch_int(T1, ACC, s);
+    return T1;
 }
 
-void CgenNode::set_parentnd(CgenNodeP p)
+// Codes a conditional; the branches leave raw values if "value" is set.
+static void code_cond(cond_class *e, bool value, ostream &s, Environment &env)
 {
-    assert(parentnd == NULL);
-    assert(p != NULL);
-    parentnd = p;
-}
+    char *cond = code_pred(e->pred, s, env);
 
-void CgenClassTable::code_class_name_tab()
-{
-    str << CLASSNAMETAB << LABEL;
+    int label_false = label_num++;
+    int label_end = label_num++;
 
-    for(auto it = cls_ordered.begin(); it != cls_ordered.end(); it++) {
-        str << WORD;
-        stringtable.lookup_string((*it)->get_name()->get_string())->code_ref(str);
-        str << endl;
+    emit_beq(cond, ZERO, label_false, s);
+    if (value) {
+        code_value(e->then_exp, s, env);
+    } else {
+        e->then_exp->code(s, env);
     }
-}
+    emit_branch(label_end, s);
 
-/*
- * Prints a table which at index (class_tag) * 4 contains the tag of the
- * corresponding parent class tag.
- */
-void CgenClassTable::code_class_parent_tab()
-{
-    str << CLASSPARENTTAB << LABEL;
-    for(auto it = cls_ordered.begin(); it != cls_ordered.end(); it++) {
-        if ((*it)->get_name() == Object) {
-            str << WORD << INVALID_CLASSTAG << endl;
-        } else {
-            str << WORD << get_class_tag((*it)->get_parent()) << endl;
-        }
+    emit_label_def(label_false, s);
+    if (value) {
+        code_value(e->else_exp, s, env);
+    } else {
+        e->else_exp->code(s, env);
     }
+
+    emit_label_def(label_end, s);
 }
 
-void CgenClassTable::code_class_obj_tab()
-{
-    str << CLASSOBJTAB << LABEL;
-    for(auto it = cls_ordered.begin(); it != cls_ordered.end(); it++) {
-        str << WORD << (*it)->get_name() << PROTOBJ_SUFFIX << endl;
-        str << WORD << (*it)->get_name() << CLASSINIT_SUFFIX << endl;
-    }
+void cond_class::code(ostream &s, Environment &env) {
+    code_cond(this, false, s, env);
 }
 
-void get_class_attrs_recursively(Class_ cls, std::vector<attr_class *> &attrs) {
-    if (cls->get_name() != Object) {
-        get_class_attrs_recursively(class_map[cls->get_parent()], attrs);
-    }
+void loop_class::code(ostream &s, Environment &env) {
+    int label_loop = label_num++;
+    int label_exit = label_num++;
+
+    emit_label_def(label_loop, s);
 
-    Features features = cls->get_features();
-    for (int i = features->first(); features->more(i); i = features->next(i)) {
-        attr_class *at = dynamic_cast<attr_class *>(features->nth(i));
+    emit_beq(code_pred(pred, s, env), ZERO, label_exit, s);
 
-        if (at) {
-            attrs.push_back(at);
-        }
-    }
+    code_effect(body, s, env);
+    emit_branch(label_loop, s);
+
+    emit_label_def(label_exit, s);
+
+    // loop always returns void
+    emit_move(ACC, ZERO, s);
 }
 
-void get_methods_recursively(Class_ cls, std::vector<std::pair<Class_, method_class *> > &methods)
+//
+// The branch of a case is chosen by the tag of the object, in $t1.
+// Without -O the tag is compared with every branch's, and then replaced
+// by its parent's from class_parentTab, until one matches.  Returns the
+// label of the first branch; the others' follow it.
+//
+static int code_case_search(Cases cases, ostream &s)
 {
-    if (cls->get_name() != Object) {
-        get_methods_recursively(class_map[cls->get_parent()], methods);
+    int label_begin = label_num++;
+    int label_tag_is_valid = label_num++;
+    int label_branch_0 = label_num;
+
+    // everytime we jump back here, T1 contains the tag of a new class
+    // if T1 is ever equal to INVALID_CLASSTAG it means that the case statement
+    // has no match which is a runtime error
+    emit_label_def(label_begin, s);
+    emit_load_imm(T2, INVALID_CLASSTAG, s);
+    emit_bne(T1, T2, label_tag_is_valid, s);
+    emit_jal("_case_abort", s);
+
+    // let's check if any of the branches have a type that matches exactly
+    // the class tag of T1
+    emit_label_def(label_tag_is_valid, s);
+
+    for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+        // $t2 = branch_i.tag
+        emit_load_imm(T2, get_class_tag(cases->nth(i)->get_type_decl()), s);
+        // if $t1 == $t2 jump to the label for the corresponding branch
+        emit_beq(T1, T2, label_num++, s);
     }
 
-    Features features = cls->get_features();
+    // none of the tags matched, so let's try get t1's parent and try again
+    // we'll go all the way to the top of the class hierarhy until we eventually
+    // have a match or have a runtime error
+    emit_load_address(T2, CLASSPARENTTAB, s);
+
+    // calculate the offset in the parent_table. $t1 holds the type's tag
+    // $t3 = $t1 * 4
+    emit_load_imm(T3, 4, s);
+    emit_mul(T3, T1, T3, s);
+    // $t2 += $t3
+    emit_add(T2, T2, T3, s);
+
+    // set $t1 to the class tag of the parent of the old $t1 value
+    emit_load(T1, 0, T2, s);
+
+    // let's go back and try again
+    emit_branch(label_begin, s);
+    return label_branch_0;
+}
 
-    for (int i = features->first(); features->more(i); i = features->next(i)) {
-        Feature f = features->nth(i);
+//
+// Under -O the classes that inherit from a branch's class have the tags
+// from its tag to its last_subclass_tags, and the intervals of two
+// branches are either nested or apart.  The branches are tried in
+// decreasing order of tag, which puts every class before the classes it
+// inherits from, so the first interval that holds the tag is that of the
+// closest branch.  When there are enough branches and their intervals
+// are dense, the branch is found by a jump table indexed by the tag
+// instead.  The table is in the code, one jump instruction per tag: the
+// data segment ends at heap_start, so it cannot go there, and jumps are
+// left alone by the peephole optimizer.  The branches' labels are
+// label_branch_0 on, in the order of cases.
+//
+#define CASE_TABLE_MIN_BRANCHES 4
 
-        method_class *method = dynamic_cast<method_class *>(f);
-        if (!method) {
-            continue; // f is an attribute not a method, so skip it
-        }
+static void code_case_tests(Cases cases, int label_branch_0, ostream &s)
+{
+    // tags and branch indexes, in decreasing order of tag
+    std::vector<std::pair<int, int> > order;
+    for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+        order.push_back(std::make_pair(get_class_tag(cases->nth(i)->get_type_decl()), i));
+    }
+    std::sort(order.rbegin(), order.rend());
 
-        bool name_already_exists = false;
-        for (auto it = methods.begin(); it != methods.end(); it++) {
-            if (it->second->get_name() == method->get_name()) {
-                name_already_exists = true;
-                it->first = cls;
+    int low = order.back().first;
+    int high = low;
+    for (auto branch : order) {
+        high = std::max(high, last_subclass_tags[branch.first]);
+    }
+    int span = high - low + 1;
+    int n = order.size();
+
+    if (n < CASE_TABLE_MIN_BRANCHES || span > 4 * n) {
+        for (auto branch : order) {
+            int tag = branch.first;
+            int last = last_subclass_tags[tag];
+            int label = label_branch_0 + branch.second;
+            if (tag == 0) {
+                // Object; nothing gets past it
+                emit_branch(label, s);
+                return;
+            }
+            if (last == tag) {
+                emit_beqi(T1, tag, label, s);
+            } else {
+                int label_next = label_num++;
+                emit_blti(T1, tag, label_next, s);
+                emit_bleqi(T1, last, label, s);
+                emit_label_def(label_next, s);
             }
         }
+        emit_jal("_case_abort", s);
+        return;
+    }
 
-        if (!name_already_exists) {
-            methods.push_back(std::make_pair(cls, method));
+    // the branch for each tag from low to high, or -1
+    std::vector<int> targets(span, -1);
+    for (auto branch : order) {
+        for (int tag = branch.first; tag <= last_subclass_tags[branch.first]; tag++) {
+            if (targets[tag - low] < 0) {
+                targets[tag - low] = branch.second;
+            }
         }
     }
-}
 
-void CgenClassTable::code_dispatch_tables()
-{
-    for(auto it_c = cls_ordered.begin(); it_c != cls_ordered.end(); it_c++) {
-        Class_ cls = *it_c;
-        str << cls->get_name() << DISPTAB_SUFFIX << LABEL;
-        get_methods_recursively(cls, cls->all_methods);
+    int label_table = label_num++;
+    int label_none = label_num++;
 
-        for (auto it_m = cls->all_methods.begin(); it_m != cls->all_methods.end(); it_m++) {
-            str << WORD << it_m->first->get_name() << "." << it_m->second->get_name() << endl;
-        }
+    // $t2 = tag - low; no branch matches unless it is below span
+    emit_addiu(T2, T1, -low, s);
+    emit_sltiu(T3, T2, span, s);
+    emit_beqz(T3, label_none, s);
+
+    // go to jump $t2 of the table
+    emit_sll(T2, T2, 2, s);
+    emit_partial_load_address(T3, s);
+    emit_label_ref(label_table, s);
+    s << endl;
+    emit_addu(T2, T2, T3, s);
+    emit_jr(T2, s);
+
+    emit_label_def(label_table, s);
+    for (int target : targets) {
+        emit_jump(target < 0 ? label_none : label_branch_0 + target, s);
     }
+
+    emit_label_def(label_none, s);
+    emit_jal("_case_abort", s);
 }
 
-void CgenClassTable::code_prototypes()
-{
-    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
-        Class_ cls = cls_ordered[i];
+void typcase_class::code(ostream &s, Environment &env) {
+    expr->code(s, env);
 
-        get_class_attrs_recursively(cls, cls->all_attrs);
+    // keep expr in a register, a slot or on the stack; the name of the
+    // branch which binds to this value will be bound later
+    char *reg = take_temp(temps_needed(cases), env);
+    int slot = -1;
+    if (reg) {
+        emit_move(reg, ACC, s);
+    } else if (fixed_frames()) {
+        slot = env.alloc_slot();
+        emit_store(ACC, slot_offset(slot), env.use_fp(), s);
+    } else {
+        emit_push(ACC, s);
+    }
 
-        str << WORD << "-1" << endl;
-        str << cls->get_name() << PROTOBJ_SUFFIX << LABEL;
-        str << WORD << i << endl; // class tag
-        str << WORD << DEFAULT_OBJFIELDS + cls->all_attrs.size() << endl; // object size
-        str << WORD << cls->get_name() << DISPTAB_SUFFIX << endl;
+    // check case on void
+    emit_bne(ACC, ZERO, label_num, s);
 
-        for (auto attr : cls->all_attrs) {
-            Symbol type = attr->get_type_decl();
-            str << WORD;
-            if (type == Int) {
-                inttable.lookup_string("0")->code_ref(str);
-            } else if (type == Bool) {
-                falsebool.code_ref(str);
-            } else if (type == Str) {
-                stringtable.lookup_string("")->code_ref(str);
-            } else {
-                str << "0";
-            }
-            str << endl;
-        }
-    }
-}
+    emit_partial_load_address(ACC, s);
+    stringtable.lookup_string(env.get_cls()->get_filename()->get_string())->code_ref(s);
+    s << endl;
+    emit_load_imm(T1, get_line_number(), s);
+    emit_jal("_case_abort2", s);
 
-void CgenClassTable::code_initializers()
-{
-    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
-        Class_ cls = cls_ordered[i];
+    // expr was not void, execution continues here. $a0 holds expr object
+    emit_label_def(label_num++, s);
 
-        str << cls->get_name() << CLASSINIT_SUFFIX << LABEL;
+    int label_end = label_num++;
 
-        emit_addiu(SP, SP, -12, str);
-        emit_store(FP, 3, SP, str);
-        emit_store(SELF, 2, SP, str);
-        emit_store(RA, 1, SP, str);
-        emit_addiu(FP, SP, 4, str);
-        emit_move(SELF, ACC, str);
+    // $t1 = expr_obj.tag
+    emit_load(T1, TAG_OFFSET, ACC, s);
 
-        if (cls->get_name() != Object) {
-            // initialize parent class first
-            str << "\tjal " << cls->get_parent() << CLASSINIT_SUFFIX << endl;
-        }
+    int label_branch_0;
+    if (cgen_optimize) {
+        label_branch_0 = label_num;
+        label_num += cases->len();
+        code_case_tests(cases, label_branch_0, s);
+    } else {
+        label_branch_0 = code_case_search(cases, s);
+    }
 
-        Environment env;
-        env.set_cls(cls);
-        for (auto attr : cls->all_attrs) {
-            env.add_cls_attr(attr);
+    // finally generate code for each branch
+    for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+        emit_label_def(label_branch_0++, s);
+
+        // bind the branch var name to expr object that is already in the
+        // register, the slot or the stack; it is not void unless assigned
+        Symbol name = cases->nth(i)->get_name();
+        bool non_void = cgen_optimize && !assigns(name, cases->nth(i)->get_expr());
+        if (reg) {
+            env.push_reg_symbol(name, reg, NULL, non_void);
+        } else if (slot >= 0) {
+            env.push_slot_symbol(name, slot, NULL, non_void);
+        } else {
+            env.push_stack_symbol(name, NULL, non_void);
         }
 
-        Features features = cls->get_features();
-        for (int i = features->first(); features->more(i); i = features->next(i)) {
-            attr_class *at = dynamic_cast<attr_class *>(features->nth(i));
+        cases->nth(i)->get_expr()->code(s, env);
 
-            if (at && !at->get_init()->is_empty()) {
-                at->get_init()->code(str, env);
-                emit_store(ACC, DEFAULT_OBJFIELDS + env.get_cls_attr_pos(at->get_name()), SELF, str);
-            }
+        if (reg || slot >= 0) {
+            env.pop_reg_symbol();
+        } else {
+            env.pop_stack_symbol();
         }
+        emit_branch(label_end, s);
+    }
 
-        emit_move(ACC, SELF, str);
-        emit_load(FP, 3, SP, str);
-        emit_load(SELF, 2, SP, str);
-        emit_load(RA, 1, SP, str);
-        emit_addiu(SP, SP, 12, str);
+    emit_label_def(label_end, s);
 
-        emit_return(str);
+    if (reg) {
+        env.free_temp();
+    } else if (slot >= 0) {
+        env.free_slot();
+    } else {
+        // pop expr from the stack
+        emit_addiu(SP, SP, 4, s);
     }
 }
 
-void CgenClassTable::code_methods()
+// Codes a block; the last expression leaves a raw value if "value" is
+// set.  The values of the others are not used.
+static void code_block(block_class *e, bool value, ostream &s, Environment &env)
 {
-    for(std::vector<Class_>::size_type i = 0; i < cls_ordered.size(); i++) {
-        Class_ cls = cls_ordered[i];
-        Symbol name = cls->get_name();
+    Expressions body = e->body;
+    for (int i = body->first(); body->more(i); i = body->next(i)) {
+        if (body->more(body->next(i))) {
+            code_effect(body->nth(i), s, env);
+        } else if (value) {
+            code_value(body->nth(i), s, env);
+        } else {
+            body->nth(i)->code(s, env);
+        }
+    }
+}
 
-        if (!is_basic_class(name)) {
-            Environment env;
-            env.set_cls(cls);
-            for (auto attr : cls->all_attrs) {
-                env.add_cls_attr(attr);
-            }
+void block_class::code(ostream &s, Environment &env) {
+    code_block(this, false, s, env);
+}
 
-            Features features = cls->get_features();
+// Codes a let; the body leaves a raw value if "value" is set.  An Int or
+// Bool variable is kept raw when there is no collector to see it and the
+// body never needs it as an object.
+static void code_let(let_class *e, bool value, ostream &s, Environment &env)
+{
+    bool raw = raw_let_vars() && is_unboxed_type(e->type_decl) &&
+               !read_boxed(e->identifier, e->body, value);
+    Symbol raw_type = raw ? e->type_decl : NULL;
 
-            for (int i = features->first(); features->more(i); i = features->next(i)) {
-                method_class *method = dynamic_cast<method_class *>(features->nth(i));
-                if (method) {
-                    method->code(str, env);
-                }
+    if (raw) {
+        if (e->init->is_empty()) {
+            emit_load_imm(ACC, 0, s);
+        } else {
+            code_value(e->init, s, env);
+        }
+    } else {
+        e->init->code(s, env);
+
+        if (e->init->is_empty()) {
+            if (e->type_decl == Str) {
+                emit_load_string(ACC, stringtable.lookup_string(""), s);
+            } else if (e->type_decl == Int) {
+                emit_load_int(ACC, inttable.lookup_string("0"), s);
+            } else if (e->type_decl == Bool) {
+                emit_load_bool(ACC, BoolConst(0), s);
             }
         }
     }
+
+    bool non_void = cgen_optimize && !e->init->is_empty() && is_non_void(e->init, env) &&
+                    !assigns(e->identifier, e->body);
+
+    char *reg = take_temp(temps_needed(e->body), env);
+    int slot = -1;
+    if (reg) {
+        emit_move(reg, ACC, s);
+        env.push_reg_symbol(e->identifier, reg, raw_type, non_void);
+    } else if (fixed_frames()) {
+        slot = env.alloc_slot();
+        emit_store(ACC, slot_offset(slot), env.use_fp(), s);
+        env.push_slot_symbol(e->identifier, slot, raw_type, non_void);
+    } else {
+        emit_push(ACC, s);
+        env.push_stack_symbol(e->identifier, raw_type, non_void);
+    }
+
+    if (value) {
+        code_value(e->body, s, env);
+    } else {
+        e->body->code(s, env);
+    }
+
+    if (reg) {
+        env.pop_reg_symbol();
+        env.free_temp();
+    } else if (slot >= 0) {
+        env.pop_reg_symbol();
+        env.free_slot();
+    } else {
+        emit_addiu(SP, SP, 4, s);
+        env.pop_stack_symbol();
+    }
 }
 
-void CgenClassTable::code()
-{
-    if (cgen_debug) cout << "coding global data" << endl;
-    code_global_data();
+void let_class::code(ostream &s, Environment &env) {
+    code_let(this, false, s, env);
+}
 
-    if (cgen_debug) cout << "choosing gc" << endl;
-    code_select_gc();
+void plus_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Int, s);
+        return;
+    }
 
-    if (cgen_debug) cout << "coding constants" << endl;
-    code_constants();
+    // eval e1 and keep the result in a register or on the stack
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
 
-    //                 Add your code to emit
-    //                   - prototype objects
-    //                   - class_nameTab
-    //                   - dispatch tables
-    //
+    // eval e2 and copy the object; the new object is in $a0
+    e2->code(s, env);
+    emit_jal("Object.copy", s);
 
-    code_class_name_tab();
-    code_class_parent_tab();
-    code_class_obj_tab();
-    code_dispatch_tables();
-    code_prototypes();
+    // $t1 = stack_pop() unless e1 is in a register; it points to e1 object
+    char *left = release_held(held, e2, T1, s, env);
 
-    //if (cgen_debug) cout << "coding global text" << endl;
-    code_global_text();
+    // $t2 = $a0; $t2 points to e2 object
+    emit_move(T2, ACC, s);
 
-    //                 Add your code to emit
-    //                   - object initializer
-    //                   - the class methods
-    //                   - etc...
+    // $t1 = e1.int
+    emit_fetch_int(T1, left, s);
+    // $t2 = $t2.int
+    emit_fetch_int(T2, T2, s);
 
-    code_initializers();
-    code_methods();
+    // $t3 = $t1 + t2
+    emit_add(T3, T1, T2, s);
+    // $a0.int = $t3
+    emit_store(T3, 3, ACC, s);
 }
 
+void sub_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Int, s);
+        return;
+    }
+
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
 
-CgenNodeP CgenClassTable::root()
-{
-   return probe(Object);
-}
+    e2->code(s, env);
+    emit_jal("Object.copy", s);
 
+    char *left = release_held(held, e2, T1, s, env);
 
-///////////////////////////////////////////////////////////////////////
-//
-// CgenNode methods
-//
-///////////////////////////////////////////////////////////////////////
+    emit_move(T2, ACC, s);
 
-CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) :
-   class__class((const class__class &) *nd),
-   parentnd(NULL),
-   children(NULL),
-   basic_status(bstatus)
-{
-    stringtable.add_string(name->get_string());          // Add class name to string table
+    emit_fetch_int(T1, left, s);
+    emit_fetch_int(T2, T2, s);
+
+    emit_sub(T3, T1, T2, s);
+    emit_store(T3, 3, ACC, s);
 }
 
+void mul_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Int, s);
+        return;
+    }
 
-//******************************************************************
-//
-//   Fill in the following methods to produce code for the
-//   appropriate expression.  You may add or remove parameters
-//   as you wish, but if you do, remember to change the parameters
-//   of the declarations in `cool-tree.h'  Sample code for
-//   constant integers, strings, and booleans are provided.
-//
-//*****************************************************************
-//
-void method_class::code(ostream &s, Environment &env)
-{
-    emit_method_ref(env.get_cls()->get_name(), name, s);
-    s << LABEL;
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
+
+    e2->code(s, env);
+    emit_jal("Object.copy", s);
 
-    // make space in the stack
-    emit_addiu(SP, SP, -(DEFAULT_OBJFIELDS * 4), s);
-    // save old $fp, self and $ra values
-    emit_store(FP, 3, SP, s);
-    emit_store(SELF, 2, SP, s);
-    emit_store(RA, 1, SP, s);
-    // set fp to point to old $ra
-    emit_addiu(FP, SP, 4, s);
-    // move acc to self
-    emit_move(SELF, ACC, s);
+    char *left = release_held(held, e2, T1, s, env);
 
-    for(int i = formals->first(); formals->more(i); i = formals->next(i)) {
-        env.add_mth_arg(formals->nth(i));
+    emit_move(T2, ACC, s);
+
+    emit_fetch_int(T1, left, s);
+    emit_fetch_int(T2, T2, s);
+
+    emit_mul(T3, T1, T2, s);
+    emit_store(T3, 3, ACC, s);
+}
+
+void divide_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Int, s);
+        return;
     }
 
-    expr->code(s, env);
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
 
-    // restore $fp, self and $ra
-    emit_load(FP, 3, SP, s);
-    emit_load(SELF, 2, SP, s);
-    emit_load(RA, 1, SP, s);
+    e2->code(s, env);
+    emit_jal("Object.copy", s);
 
-    // destroy the stack frame
-    emit_addiu(SP, SP, (DEFAULT_OBJFIELDS + env.get_mth_args_size()) * 4, s);
-    env.clear_mth_args();
+    char *left = release_held(held, e2, T1, s, env);
 
-    s << RET << "\n";
+    emit_move(T2, ACC, s);
+
+    emit_fetch_int(T1, left, s);
+    emit_fetch_int(T2, T2, s);
+
+    emit_div(T3, T1, T2, s);
+    emit_store(T3, 3, ACC, s);
 }
 
-void assign_class::code(ostream &s, Environment &env) {
-    expr->code(s, env);
-    int pos, offset;
+void neg_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Int, s);
+        return;
+    }
 
-    pos = env.get_let_var_pos_rev(name);
-    if (pos != -1) {
-        offset = pos + 1;
-        emit_store(ACC, offset, SP, s);
+    e1->code(s, env);
+    emit_jal("Object.copy", s);
 
-        if (cgen_Memmgr == GC_GENGC) {
-            emit_addiu(A1, SP, 4 * offset, s);
-            emit_gc_assign(s);
-        }
+    emit_fetch_int(T1, ACC, s);
+    emit_neg(T1, T1, s);
+    emit_store(T1, 3, ACC, s);
+}
+
+void lt_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Bool, s);
         return;
     }
 
-    pos = env.get_arg_pos(name);
-    if (pos != -1) {
-        offset = 2 + env.get_mth_args_size() - pos;
-        emit_store(ACC, offset, FP, s);
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
 
-        if (cgen_Memmgr == GC_GENGC) {
-            emit_addiu(A1, FP, 4 * offset, s);
-            emit_gc_assign(s);
-        }
+    e2->code(s, env);
+
+    char *left = release_held(held, e2, T1, s, env);
+
+    emit_move(T2, ACC, s);
+
+    emit_fetch_int(T1, left, s);
+    emit_fetch_int(T2, T2, s);
+
+    emit_load_bool(ACC, BoolConst(1), s);
+    emit_blt(T1, T2, label_num, s);
+
+    emit_load_bool(ACC, BoolConst(0), s);
+    emit_label_def(label_num++, s);
+}
+
+void eq_class::code(ostream &s, Environment &env) {
+    if (unboxing() && compares_values(this)) {
+        code_value(this, s, env);
+        emit_box(Bool, s);
         return;
     }
 
-    pos = env.get_cls_attr_pos(name);
-    if (pos != -1) {
-        offset = DEFAULT_OBJFIELDS + pos;
-        emit_store(ACC, offset, SELF, s);
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
 
-        if (cgen_Memmgr == GC_GENGC) {
-            emit_addiu(A1, SELF, 4 * offset, s);
-            emit_gc_assign(s);
-        }
+    e2->code(s, env);
+
+    // equality_test takes the objects in $t1 and $t2
+    char *left = release_held(held, e2, T1, s, env);
+    if (held) {
+        emit_move(T1, left, s);
+    }
+
+    emit_move(T2, ACC, s);
+
+    if (e1->type == Int || e1->type == Str || e1->type == Bool) {
+        emit_load_bool(ACC, BoolConst(1), s);
+        emit_load_bool(A1, BoolConst(0), s);
+        emit_jal("equality_test", s);
         return;
     }
+
+    emit_load_bool(ACC, BoolConst(1), s);
+    emit_beq(T1, T2, label_num, s);
+    emit_load_bool(ACC, BoolConst(0), s);
+    emit_label_def(label_num++, s);
 }
 
-void static_dispatch_class::code(ostream &s, Environment &env) {
-    int num_params = 0;
+void leq_class::code(ostream &s, Environment &env) {
+    if (unboxing()) {
+        code_value(this, s, env);
+        emit_box(Bool, s);
+        return;
+    }
 
-    for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
-        actual->nth(i)->code(s, env);
-        emit_push(ACC, s);
-        env.push_stack_symbol(No_type);
+    e1->code(s, env);
+    char *held = hold_acc(e2, s, env);
 
-        num_params++;
-    }
+    e2->code(s, env);
 
-    // $a0 = expr_obj
-    expr->code(s, env);
+    char *left = release_held(held, e2, T1, s, env);
 
-    // catch dispatch on void
-    // if $a0 != 0 then jump to labelx
-    emit_bne(ACC, ZERO, label_num, s);
+    emit_move(T2, ACC, s);
 
-    //s << "\tla\t" << ACC << " ";
-    emit_partial_load_address(ACC, s);
-    stringtable.lookup_string(env.get_cls()->get_filename()->get_string())->code_ref(s);
-    s << endl;
-    emit_load_imm(T1, get_line_number(), s);
-    emit_jal("_dispatch_abort", s);
+    emit_fetch_int(T1, left, s);
+    emit_fetch_int(T2, T2, s);
+
+    emit_load_bool(ACC, BoolConst(1), s);
+    emit_bleq(T1, T2, label_num, s);
 
-    // labelx...
+    emit_load_bool(ACC, BoolConst(0), s);
     emit_label_def(label_num++, s);
+}
 
-    // $t1 = type_name_dispatch_pointer
-    emit_load_address(T1, (char *) (std::string(type_name->get_string()) + DISPTAB_SUFFIX).c_str(), s);
+void comp_class::code(ostream &s, Environment &env) {
+    if (unboxing() && has_raw_code(e1, env)) {
+        code_value(e1, s, env);
+        emit_move(T1, ACC, s);
+    } else {
+        e1->code(s, env);
+        emit_fetch_int(T1, ACC, s);
+    }
 
-    Class_ cls = class_map[type_name];
+    emit_load_bool(ACC, BoolConst(1), s);
 
-    int i;
-    for (i = 0; i < (int) cls->all_methods.size(); i++) {
-        if (cls->all_methods[i].second->get_name() == name) {
-            break;
-        }
-    }
+    emit_beq(T1, ZERO, label_num, s);
+    emit_load_bool(ACC, BoolConst(0), s);
 
-    // $t1 += offset_to_proper_func
-    emit_load(T1, i, T1, s);
-    // set $ra to next instruction and jump to $t1
-    emit_jalr(T1, s);
+    emit_label_def(label_num++, s);
+}
 
-    for (int i = 0; i < num_params; i++) {
-        // this simply removes the symbols from the vector
-        // the callee is responsible for actually increasing the $sp
-        env.pop_stack_symbol();
+void int_const_class::code(ostream& s, Environment &env) {
+    emit_load_int(ACC,inttable.lookup_string(token->get_string()),s);
+    if (fresh) {
+        emit_jal("Object.copy", s);
     }
 }
 
-void dispatch_class::code(ostream &s, Environment &env) {
-    int num_params = 0;
-
-    for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
-        actual->nth(i)->code(s, env);
-        emit_push(ACC, s);
-        env.push_stack_symbol(No_type);
+void string_const_class::code(ostream& s, Environment &env) {
+    emit_load_string(ACC,stringtable.lookup_string(token->get_string()),s);
+}
 
-        num_params++;
-    }
+void bool_const_class::code(ostream& s, Environment &env) {
+    emit_load_bool(ACC, BoolConst(val), s);
+}
 
-    // $a0 = expr_obj
-    expr->code(s, env);
+//
+// Allocation.  Under -O new T, for a class T of at most NEW_INLINE_ATTRS
+// attributes, does not copy T's prototype with Object.copy.  It bumps the
+// heap pointer $gp by the size of the object and only if that passes the
+// limit $s7 undoes it and calls _MemMgr_Alloc, which collects.  Then it
+// stores the words of the prototype, which are known, loading each value
+// once.  If no attribute of T or of a class it inherits from has an
+// initializer other than a constant, the constants are stored as well
+// and T_init is not called.  With -t every allocation goes through
+// Object.copy, which runs the collector.
+//
+#define NEW_INLINE_ATTRS 8
 
-    // catch dispatch on void
-    // if $a0 != 0 then jump to labelx
-    emit_bne(ACC, ZERO, label_num, s);
+static bool is_constant_kind(Expression e)
+{
+    // folded arithmetic is not: it makes a new object
+    return (e->get_kind() == int_const_kind && !static_cast<int_const_class *>(e)->fresh) ||
+           e->get_kind() == bool_const_kind || e->get_kind() == string_const_kind;
+}
 
-    emit_partial_load_address(ACC, s);
-    stringtable.lookup_string(env.get_cls()->get_filename()->get_string())->code_ref(s);
-    s << endl;
-    emit_load_imm(T1, get_line_number(), s);
-    emit_jal("_dispatch_abort", s);
+// Loads into $t1 the value attribute attr of a new object starts with:
+// its initializer, a constant, if init is set, and otherwise the default
+// of its type.  Returns false without loading anything if that is 0.
+static bool load_attr_value(attr_class *attr, bool init, ostream &s)
+{
+    Expression e = attr->get_init();
+    if (init && e->get_kind() == int_const_kind) {
+        emit_load_int(T1, inttable.lookup_string(static_cast<int_const_class *>(e)->token->get_string()), s);
+    } else if (init && e->get_kind() == string_const_kind) {
+        emit_load_string(T1, stringtable.lookup_string(static_cast<string_const_class *>(e)->token->get_string()), s);
+    } else if (init && e->get_kind() == bool_const_kind) {
+        emit_load_bool(T1, BoolConst(static_cast<bool_const_class *>(e)->val), s);
+    } else if (attr->get_type_decl() == Int) {
+        emit_load_int(T1, inttable.lookup_string("0"), s);
+    } else if (attr->get_type_decl() == Bool) {
+        emit_load_bool(T1, falsebool, s);
+    } else if (attr->get_type_decl() == Str) {
+        emit_load_string(T1, stringtable.lookup_string(""), s);
+    } else {
+        return false;
+    }
+    return true;
+}
 
-    // labelx...
-    emit_label_def(label_num++, s);
+// each distinct load of $t1, and the offsets in the new object its value
+// is stored at
+typedef std::vector<std::pair<std::string, std::vector<int> > > ObjectStores;
 
-    // $t1 = expr_obj.dispatch_pointer
-    emit_load(T1, 2, ACC, s);
+static void add_store(ObjectStores &stores, const AsmStream &load, int offset)
+{
+    std::string text(load.data(), load.size());
+    for (auto &st : stores) {
+        if (st.first == text) {
+            st.second.push_back(offset);
+            return;
+        }
+    }
+    stores.push_back(std::make_pair(text, std::vector<int>(1, offset)));
+}
 
-    Class_ cls = env.get_cls();
-    if (expr->get_type() != SELF_TYPE) {
-        cls = class_map[expr->get_type()];
+// Codes new cls in $a0; returns whether the object still needs cls_init.
+static bool code_inline_new(Class_ cls, ostream &s)
+{
+    bool needs_init = false;
+    for (auto attr : cls->all_attrs) {
+        Expression e = attr->get_init();
+        needs_init = needs_init || !(e->is_empty() || is_constant_kind(e));
     }
 
-    int i;
-    for (i = 0; i < (int) cls->all_methods.size(); i++) {
-        if (cls->all_methods[i].second->get_name() == name) {
-            break;
+    int words = DEFAULT_OBJFIELDS + cls->all_attrs.size();
+    int bytes = (words + 1) * WORD_SIZE;     // and the eye catcher
+    int allocated = label_num++;
+    emit_addiu(GP, GP, bytes, s);
+    emit_blt(GP, S7, allocated, s);
+    emit_addiu(GP, GP, -bytes, s);
+    emit_load_imm(ACC, bytes, s);
+    emit_jal("_MemMgr_Alloc", s);
+    emit_label_def(allocated, s);
+    emit_addiu(ACC, GP, WORD_SIZE - bytes, s);
+
+    ObjectStores stores;
+    int tag = get_class_tag(cls->get_name());
+    AsmStream eye_catcher(64), tag_word(64), size_word(64), disp_word(64);
+    emit_load_imm(T1, -1, eye_catcher);
+    add_store(stores, eye_catcher, -1);
+    emit_load_imm(T1, tag, tag_word);
+    add_store(stores, tag_word, TAG_OFFSET);
+    emit_load_imm(T1, words, size_word);
+    add_store(stores, size_word, SIZE_OFFSET);
+    emit_partial_load_address(T1, disp_word);
+    emit_disptable_ref(cls->get_name(), disp_word);
+    disp_word << endl;
+    add_store(stores, disp_word, DISPTABLE_OFFSET);
+
+    for (int i = 0; i < (int) cls->all_attrs.size(); i++) {
+        AsmStream value(64);
+        if (load_attr_value(cls->all_attrs[i], !needs_init, value)) {
+            add_store(stores, value, DEFAULT_OBJFIELDS + i);
+        } else {
+            emit_store(ZERO, DEFAULT_OBJFIELDS + i, ACC, s);
         }
     }
-
-    // $t1 += offset_to_proper_func
-    emit_load(T1, i, T1, s);
-    // set $ra to next instruction and jump to $t1
-    emit_jalr(T1, s);
-
-    for (int i = 0; i < num_params; i++) {
-        // this simply removes the symbols from the vector
-        // the callee is responsible for actually increasing the $sp
-        env.pop_stack_symbol();
+    for (auto &st : stores) {
+        s << st.first;
+        for (int offset : st.second) {
+            emit_store(T1, offset, ACC, s);
+        }
     }
+    return needs_init;
 }
 
-void cond_class::code(ostream &s, Environment &env) {
-    pred->code(s, env);
-    emit_fetch_int(T1, ACC, s);
+void new__class::code(ostream &s, Environment &env) {
+    if (type_name != SELF_TYPE && cgen_optimize && cgen_Memmgr_Test != GC_TEST &&
+        get_class(type_name)->all_attrs.size() <= NEW_INLINE_ATTRS) {
+        if (code_inline_new(get_class(type_name), s)) {
+            emit_jal((char *) (std::string(type_name->get_string()) + CLASSINIT_SUFFIX).c_str(), s);
+        }
+        return;
+    }
 
-    int label_false = label_num++;
-    int label_end = label_num++;
+    if (type_name != SELF_TYPE) {
+        emit_load_address(ACC, (char *) (std::string(type_name->get_string()) + PROTOBJ_SUFFIX).c_str(), s);
+        emit_jal("Object.copy", s);
+        emit_jal((char *) (std::string(type_name->get_string()) + CLASSINIT_SUFFIX).c_str(), s);
+        return;
+    }
 
-    emit_beq(T1, ZERO, label_false, s);
-    then_exp->code(s, env);
-    emit_branch(label_end, s);
+    emit_load_address(T1, CLASSOBJTAB, s);
 
-    emit_label_def(label_false, s);
-    else_exp->code(s, env);
+    // $t2 = self.tag
+    emit_load(T2, 0, env.use_self(), s);
+    // $t2 = $t2 * 8
+    emit_load_imm(T3, 8, s);
+    emit_mul(T2, T2, T3, s);
+    // $t1 += offset in the CLASSOBJTAB
+    emit_addu(T1, T1, T2, s);
+    // $t1 now points to SELF_TYPE_CLASS_protObj
 
-    emit_label_def(label_end, s);
-}
+    // keep $t1 in a slot, or push it to the stack
+    int slot = -1;
+    if (fixed_frames()) {
+        slot = env.alloc_slot();
+        emit_store(T1, slot_offset(slot), env.use_fp(), s);
+    } else {
+        emit_push(T1, s);
+    }
 
-void loop_class::code(ostream &s, Environment &env) {
-    int label_loop = label_num++;
-    int label_exit = label_num++;
+    emit_load(ACC, 0, T1, s);
+    emit_jal("Object.copy", s);
 
-    emit_label_def(label_loop, s);
+    // get the old pointer back to $t1
+    if (slot >= 0) {
+        env.free_slot();
+        emit_load(T1, slot_offset(slot), env.use_fp(), s);
+    } else {
+        emit_addiu(SP, SP, 4, s);
+        emit_load(T1, 0, SP, s);
+    }
 
-    pred->code(s, env);
+    // $t1 += 1 so it now points to SELF_TYPE_CLASS_init
+    emit_load(T1, 1, T1, s);
+    emit_jalr(T1, s);
+}
 
-    emit_fetch_int(T1, ACC, s);
-    emit_beq(T1, ZERO, label_exit, s);
+void isvoid_class::code(ostream &s, Environment &env) {
+    e1->code(s, env);
+    emit_move(T1, ACC, s);
 
-    body->code(s, env);
-    emit_branch(label_loop, s);
+    emit_load_bool(ACC, BoolConst(1), s);
 
-    emit_label_def(label_exit, s);
+    emit_beq(T1, ZERO, label_num, s);
+    emit_load_bool(ACC, BoolConst(0), s);
 
-    // loop always returns void
+    emit_label_def(label_num++, s);
+}
+
+void no_expr_class::code(ostream &s, Environment &env) {
     emit_move(ACC, ZERO, s);
 }
 
-void typcase_class::code(ostream &s, Environment &env) {
-    expr->code(s, env);
+void object_class::code(ostream &s, Environment &env) {
+    int pos;
 
-    // push expr onto the stack
-    // the name of the env whichs binds to this value will be pushed later
-    emit_push(ACC, s);
+    char *reg = env.get_let_var_reg(name);
+    if (reg) {
+        emit_move(ACC, reg, s);
+        if (env.is_raw_let_var(name)) {
+            emit_box(env.get_raw_let_var_type(name), s);
+        }
+        return;
+    }
 
-    // check case on void
-    emit_bne(ACC, ZERO, label_num, s);
+    pos = env.get_let_var_slot(name);
+    if (pos != -1) {
+        emit_load(ACC, slot_offset(pos), env.use_fp(), s);
+        if (env.is_raw_let_var(name)) {
+            emit_box(env.get_raw_let_var_type(name), s);
+        }
+        return;
+    }
 
-    emit_partial_load_address(ACC, s);
-    stringtable.lookup_string(env.get_cls()->get_filename()->get_string())->code_ref(s);
-    s << endl;
-    emit_load_imm(T1, get_line_number(), s);
-    emit_jal("_case_abort2", s);
+    pos = env.get_let_var_pos_rev(name);
+    if (pos != -1) {
+        emit_load(ACC, pos + 1, SP, s);
+        if (env.is_raw_let_var(name)) {
+            emit_box(env.get_raw_let_var_type(name), s);
+        }
+        return;
+    }
 
-    // expr was not void, execution continues here. $a0 holds expr object
-    emit_label_def(label_num++, s);
+    pos = env.get_arg_pos(name);
+    if (pos != -1) {
+        emit_load(ACC, 2 + env.get_mth_args_size() - pos, env.use_fp(), s);
+        return;
+    }
 
-    int label_begin = label_num++;
-    int label_end = label_num++;
-    int label_tag_is_valid = label_num++;
+    pos = env.get_cls_attr_pos(name);
+    if (pos != -1) {
+        emit_load(ACC, DEFAULT_OBJFIELDS + pos, env.use_self(), s);
+        return;
+    }
 
-    // $t1 = expr_obj.tag
-    emit_load(T1, TAG_OFFSET, ACC, s);
+    // name == self
+    emit_move(ACC, env.use_self(), s);
+}
 
-    // everytime we jump back here, T1 contains the tag of a new class
-    // if T1 is ever equal to INVALID_CLASSTAG it means that the case statement
-    // has no match which is a runtime error
-    emit_label_def(label_begin, s);
-    emit_load_imm(T2, INVALID_CLASSTAG, s);
-    emit_bne(T1, T2, label_tag_is_valid, s);
-    emit_jal("_case_abort", s);
+//
+// Raw values (see "Unboxed Int and Bool values" above).  ValueCoder codes
+// an Int or Bool expression so that it leaves the raw value in $a0;
+// expressions that have no cheaper way compute the object and fetch its
+// value.
+//
+struct ValueCoder {
+    typedef void result_type;
 
-    // let's check if any of the branches have a type that matches exactly
-    // the class tag of T1
-    emit_label_def(label_tag_is_valid, s);
+    ostream &s;
+    Environment &env;
 
-    int label_branch_0 = label_num;
+    ValueCoder(ostream &s, Environment &env) : s(s), env(env) { }
 
-    for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
-        // $t2 = branch_i.tag
-        emit_load_imm(T2, get_class_tag(cases->nth(i)->get_type_decl()), s);
-        // if $t1 == $t2 jump to the label for the corresponding branch
-        emit_beq(T1, T2, label_num++, s);
+    template <class E> void visit(E *e) {
+        e->code(s, env);
+        emit_fetch_int(ACC, ACC, s);
     }
 
-    // none of the tags matched, so let's try get t1's parent and try again
-    // we'll go all the way to the top of the class hierarhy until we eventually
-    // have a match or have a runtime error
-    emit_load_address(T2, CLASSPARENTTAB, s);
+    void visit(int_const_class *e) {
+        emit_load_imm(ACC, atoi(e->token->get_string()), s);
+    }
 
-    // calculate the offset in the parent_table. $t1 holds the type's tag
-    // $t3 = $t1 * 4
-    emit_load_imm(T3, 4, s);
-    emit_mul(T3, T1, T3, s);
-    // $t2 += $t3
-    emit_add(T2, T2, T3, s);
+    void visit(bool_const_class *e) {
+        emit_load_imm(ACC, e->val, s);
+    }
 
-    // set $t1 to the class tag of the parent of the old $t1 value
-    emit_load(T1, 0, T2, s);
+    void visit(plus_class *e) {
+        char *left = code_operands(e->e1, e->e2, s, env);
+        emit_add(ACC, left, ACC, s);
+    }
 
-    // let's go back and try again
-    emit_branch(label_begin, s);
+    void visit(sub_class *e) {
+        char *left = code_operands(e->e1, e->e2, s, env);
+        emit_sub(ACC, left, ACC, s);
+    }
 
-    // finally generate code for each branch
-    for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
-        emit_label_def(label_branch_0++, s);
+    // multiplying by 2^k is shifting left by k, and a constant operand
+    // can be evaluated in either order
+    void visit(mul_class *e) {
+        int k;
+        if ((k = power_of_two(e->e2)) >= 0) {
+            code_value(e->e1, s, env);
+        } else if ((k = power_of_two(e->e1)) >= 0) {
+            code_value(e->e2, s, env);
+        } else {
+            char *left = code_operands(e->e1, e->e2, s, env);
+            emit_mul(ACC, left, ACC, s);
+            return;
+        }
+        if (k > 0) {
+            emit_sll(ACC, ACC, k, s);
+        }
+    }
 
-        // bind the branch var name to expr object that is already in the stack
-        env.push_stack_symbol(cases->nth(i)->get_name());
+    // dividing by 2^k is shifting right by k, after adding 2^k - 1 to a
+    // negative dividend so that the quotient is rounded toward zero
+    void visit(divide_class *e) {
+        int k = power_of_two(e->e2);
+        if (k < 0) {
+            char *left = code_operands(e->e1, e->e2, s, env);
+            emit_div(ACC, left, ACC, s);
+            return;
+        }
+        code_value(e->e1, s, env);
+        if (k > 0) {
+            emit_sra(T1, ACC, 31, s);
+            emit_srl(T1, T1, 32 - k, s);
+            emit_addu(ACC, ACC, T1, s);
+            emit_sra(ACC, ACC, k, s);
+        }
+    }
 
-        cases->nth(i)->get_expr()->code(s, env);
+    void visit(neg_class *e) {
+        code_value(e->e1, s, env);
+        emit_neg(ACC, ACC, s);
+    }
 
-        env.pop_stack_symbol();
-        emit_branch(label_end, s);
+    void visit(lt_class *e) {
+        char *left = code_operands(e->e1, e->e2, s, env);
+        emit_slt(ACC, left, ACC, s);
     }
 
-    emit_label_def(label_end, s);
+    // a <= b is !(b < a)
+    void visit(leq_class *e) {
+        char *left = code_operands(e->e1, e->e2, s, env);
+        emit_slt(ACC, ACC, left, s);
+        emit_xori(ACC, ACC, 1, s);
+    }
 
-    // pop expr from the stack
-    emit_addiu(SP, SP, 4, s);
-}
+    void visit(eq_class *e) {
+        if (!compares_values(e)) {
+            visit<eq_class>(e);
+            return;
+        }
+        char *left = code_operands(e->e1, e->e2, s, env);
+        emit_seq(ACC, left, ACC, s);
+    }
 
-void block_class::code(ostream &s, Environment &env) {
-    for (int i = body->first(); body->more(i); i = body->next(i)) {
-        body->nth(i)->code(s, env);
+    void visit(comp_class *e) {
+        code_value(e->e1, s, env);
+        emit_xori(ACC, ACC, 1, s);
     }
-}
 
-void let_class::code(ostream &s, Environment &env) {
-    init->code(s, env);
+    void visit(isvoid_class *e) {
+        e->e1->code(s, env);
+        emit_seq(ACC, ACC, ZERO, s);
+    }
 
-    if (init->is_empty()) {
-        if (type_decl == Str) {
-            emit_load_string(ACC, stringtable.lookup_string(""), s);
-        } else if (type_decl == Int) {
-            emit_load_int(ACC, inttable.lookup_string("0"), s);
-        } else if (type_decl == Bool) {
-            emit_load_bool(ACC, BoolConst(0), s);
+    void visit(cond_class *e)           { code_cond(e, true, s, env); }
+    void visit(block_class *e)          { code_block(e, true, s, env); }
+    void visit(let_class *e)            { code_let(e, true, s, env); }
+
+    void visit(assign_class *e) {
+        if (!env.is_raw_let_var(e->name)) {
+            visit<assign_class>(e);
+            return;
         }
+        code_raw_assign(e, s, env);
     }
 
-    emit_push(ACC, s);
-    env.push_stack_symbol(identifier);
-
-    body->code(s, env);
+    void visit(object_class *e) {
+        if (!env.is_raw_let_var(e->name)) {
+            visit<object_class>(e);
+            return;
+        }
+        char *reg = env.get_let_var_reg(e->name);
+        int slot = env.get_let_var_slot(e->name);
+        if (reg) {
+            emit_move(ACC, reg, s);
+        } else if (slot >= 0) {
+            emit_load(ACC, slot_offset(slot), env.use_fp(), s);
+        } else {
+            emit_load(ACC, env.get_let_var_pos_rev(e->name) + 1, SP, s);
+        }
+    }
+};
 
-    emit_addiu(SP, SP, 4, s);
-    env.pop_stack_symbol();
+static void code_value(Expression e, ostream &s, Environment &env)
+{
+    ValueCoder coder(s, env);
+    visit(e, coder);
 }
 
-void plus_class::code(ostream &s, Environment &env) {
-    // eval e1 and put the result on the stack
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
-
-    // eval e2 and copy the object; the new object is in $a0
-    e2->code(s, env);
-    emit_jal("Object.copy", s);
+// Is the raw value of e no dearer than its object?  True of what computes
+// the value (and would box it) and of raw variables, but not of what has
+// to fetch it from an object.  Only asked of Int and Bool expressions.
+struct RawCost {
+    typedef bool result_type;
+
+    Environment &env;
+
+    RawCost(Environment &env) : env(env) { }
+
+    template <class E> bool visit(E *e)  { return false; }
+
+    bool visit(int_const_class *e)      { return true; }
+    bool visit(bool_const_class *e)     { return true; }
+    bool visit(plus_class *e)           { return true; }
+    bool visit(sub_class *e)            { return true; }
+    bool visit(mul_class *e)            { return true; }
+    bool visit(divide_class *e)         { return true; }
+    bool visit(neg_class *e)            { return true; }
+    bool visit(lt_class *e)             { return true; }
+    bool visit(leq_class *e)            { return true; }
+    bool visit(comp_class *e)           { return true; }
+    bool visit(eq_class *e)             { return compares_values(e); }
+    bool visit(cond_class *e)           { return true; }
+    bool visit(block_class *e)          { return true; }
+    bool visit(let_class *e)            { return true; }
+    bool visit(assign_class *e)         { return env.is_raw_let_var(e->name); }
+    bool visit(object_class *e)         { return env.is_raw_let_var(e->name); }
+};
+
+static bool has_raw_code(Expression e, Environment &env)
+{
+    RawCost cost(env);
+    return visit(e, cost);
+}
 
-    // $t1 = stack_pop(); $t1 points to e1 object
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+// Codes an expression whose value is not used.
+static void code_effect(Expression e, ostream &s, Environment &env)
+{
+    if (unboxing() && is_unboxed_type(e->get_type()) && has_raw_code(e, env)) {
+        code_value(e, s, env);
+    } else {
+        e->code(s, env);
+    }
+}
 
-    // $t2 = $a0; $t2 points to e2 object
-    emit_move(T2, ACC, s);
+//
+// Constant folding, under -O.  Before any code is generated, every
+// method body and attribute initializer is rewritten:
+//
+//   - arithmetic, comparisons, not and ~ on constants are replaced by
+//     their values;
+//   - a let variable that is initialized to a constant of its own type
+//     and never assigned is replaced by the constant, and the let by its
+//     body;
+//   - an if whose predicate is constant is replaced by the branch taken.
+//
+// Values are those the generated code computes: 32-bit, with * wrapping
+// around.  What would trap at run time (+ or - overflowing, ~ of the
+// least Int, division by zero or of the least Int by -1) is left alone,
+// so it still does.
+//
+// A replacement keeps the static type of what it replaces, which may be
+// wider than its own (a branch of an if typed Object, say), so that code
+// that goes by the type, like = on objects, does not change.  Folded
+// arithmetic is marked fresh: it is coded as a copy of the constant's Int
+// object, as the arithmetic would have made a new one, so = on Objects
+// cannot tell the difference either.  A let variable initialized to it
+// is therefore not replaced, as all its uses have to give the same
+// object.
+//
 
-    // $t1 = $t1.int
-    emit_fetch_int(T1, T1, s);
-    // $t2 = $t2.int
-    emit_fetch_int(T2, T2, s);
+// Does e assign to a variable called name?  Shadowing is not taken into
+// account, so the answer may be yes when it is no.
 
-    // $t3 = $t1 + t2
-    emit_add(T3, T1, T2, s);
-    // $a0.int = $t3
-    emit_store(T3, 3, ACC, s);
-}
+struct AssignFinder {
+    typedef bool result_type;
 
-void sub_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
+    Symbol name;
 
-    e2->code(s, env);
-    emit_jal("Object.copy", s);
+    bool in(Expression e)  { return assigns(name, e); }
 
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+    bool in(Expressions es) {
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            if (in(es->nth(i))) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-    emit_move(T2, ACC, s);
+    bool visit(assign_class *e)          { return e->name == name || in(e->expr); }
+    bool visit(static_dispatch_class *e) { return in(e->expr) || in(e->actual); }
+    bool visit(dispatch_class *e)        { return in(e->expr) || in(e->actual); }
+    bool visit(cond_class *e)            { return in(e->pred) || in(e->then_exp) || in(e->else_exp); }
+    bool visit(loop_class *e)            { return in(e->pred) || in(e->body); }
+    bool visit(block_class *e)           { return in(e->body); }
+    bool visit(let_class *e)             { return in(e->init) || in(e->body); }
+    bool visit(plus_class *e)            { return in(e->e1) || in(e->e2); }
+    bool visit(sub_class *e)             { return in(e->e1) || in(e->e2); }
+    bool visit(mul_class *e)             { return in(e->e1) || in(e->e2); }
+    bool visit(divide_class *e)          { return in(e->e1) || in(e->e2); }
+    bool visit(lt_class *e)              { return in(e->e1) || in(e->e2); }
+    bool visit(eq_class *e)              { return in(e->e1) || in(e->e2); }
+    bool visit(leq_class *e)             { return in(e->e1) || in(e->e2); }
+    bool visit(neg_class *e)             { return in(e->e1); }
+    bool visit(comp_class *e)            { return in(e->e1); }
+    bool visit(isvoid_class *e)          { return in(e->e1); }
+    bool visit(int_const_class *e)       { return false; }
+    bool visit(bool_const_class *e)      { return false; }
+    bool visit(string_const_class *e)    { return false; }
+    bool visit(new__class *e)            { return false; }
+    bool visit(no_expr_class *e)         { return false; }
+    bool visit(object_class *e)          { return false; }
+
+    bool visit(typcase_class *e) {
+        if (in(e->expr)) {
+            return true;
+        }
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            if (in(e->cases->nth(i)->get_expr())) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
-    emit_fetch_int(T1, T1, s);
-    emit_fetch_int(T2, T2, s);
+static bool assigns(Symbol name, Expression e)
+{
+    AssignFinder finder = { name };
+    return visit(e, finder);
+}
 
-    emit_sub(T3, T1, T2, s);
-    emit_store(T3, 3, ACC, s);
+// The value of an Int constant, if e is one that fits in 32 bits.
+static bool int_value(Expression e, int &value)
+{
+    if (e->get_kind() != int_const_kind) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    long v = strtol(static_cast<int_const_class *>(e)->token->get_string(), &end, 10);
+    if (errno || *end || v < INT_MIN || v > INT_MAX) {
+        return false;
+    }
+    value = v;
+    return true;
 }
 
-void mul_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
+static bool bool_value(Expression e, bool &value)
+{
+    if (e->get_kind() != bool_const_kind) {
+        return false;
+    }
+    value = static_cast<bool_const_class *>(e)->val;
+    return true;
+}
 
-    e2->code(s, env);
-    emit_jal("Object.copy", s);
+static bool is_constant(Expression e)
+{
+    int i;
+    return int_value(e, i) || e->get_kind() == bool_const_kind ||
+           e->get_kind() == string_const_kind;
+}
 
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+// Is e the value of folded arithmetic, which stands for a new Int?
+static bool is_fresh(Expression e)
+{
+    return e->get_kind() == int_const_kind && static_cast<int_const_class *>(e)->fresh;
+}
 
-    emit_move(T2, ACC, s);
+struct ConstantFolder {
+    typedef Expression result_type;
 
-    emit_fetch_int(T1, T1, s);
-    emit_fetch_int(T2, T2, s);
+    // the let variables in scope, innermost last, with their constant
+    // values; NULL for a variable that is not constant
+    std::vector<std::pair<Symbol, Expression> > scope;
 
-    emit_mul(T3, T1, T2, s);
-    emit_store(T3, 3, ACC, s);
-}
+    Expression fold(Expression e) {
+        return ::visit(e, *this);
+    }
 
-void divide_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
+    Expressions fold(Expressions es) {
+        Expressions folded = nil_Expressions();
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            folded = append_Expressions(folded, single_Expressions(fold(es->nth(i))));
+        }
+        return folded;
+    }
 
-    e2->code(s, env);
-    emit_jal("Object.copy", s);
+    // e, a new node, in the place of "old"
+    static Expression replace(Expression old, Expression e) {
+        e->set(old);
+        return e->set_type(old->get_type());
+    }
 
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+    static Expression int_result(Expression old, long long value) {
+        int_const_class *e = static_cast<int_const_class *>(int_const(inttable.add_int(value)));
+        e->fresh = true;
+        return replace(old, e);
+    }
 
-    emit_move(T2, ACC, s);
+    static Expression bool_result(Expression old, bool value) {
+        return replace(old, bool_const(value));
+    }
 
-    emit_fetch_int(T1, T1, s);
-    emit_fetch_int(T2, T2, s);
+    // + and - are folded only if they do not overflow
+    static Expression fits(Expression old, long long value) {
+        return value < INT_MIN || value > INT_MAX ? old : int_result(old, value);
+    }
 
-    emit_div(T3, T1, T2, s);
-    emit_store(T3, 3, ACC, s);
-}
+    Expression visit(plus_class *e) {
+        int a, b;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        return int_value(e->e1, a) && int_value(e->e2, b) ? fits(e, (long long) a + b) : e;
+    }
 
-void neg_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_jal("Object.copy", s);
+    Expression visit(sub_class *e) {
+        int a, b;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        return int_value(e->e1, a) && int_value(e->e2, b) ? fits(e, (long long) a - b) : e;
+    }
 
-    emit_fetch_int(T1, ACC, s);
-    emit_neg(T1, T1, s);
-    emit_store(T1, 3, ACC, s);
-}
+    Expression visit(mul_class *e) {
+        int a, b;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        if (int_value(e->e1, a) && int_value(e->e2, b)) {
+            return int_result(e, (int) ((unsigned) a * (unsigned) b));
+        }
+        return e;
+    }
 
-void lt_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
+    Expression visit(divide_class *e) {
+        int a, b;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        if (int_value(e->e1, a) && int_value(e->e2, b) && b != 0 && !(a == INT_MIN && b == -1)) {
+            return int_result(e, a / b);
+        }
+        return e;
+    }
 
-    e2->code(s, env);
+    Expression visit(neg_class *e) {
+        int a;
+        e->e1 = fold(e->e1);
+        return int_value(e->e1, a) && a != INT_MIN ? int_result(e, -a) : e;
+    }
 
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+    Expression visit(lt_class *e) {
+        int a, b;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        return int_value(e->e1, a) && int_value(e->e2, b) ? bool_result(e, a < b) : e;
+    }
 
-    emit_move(T2, ACC, s);
+    Expression visit(leq_class *e) {
+        int a, b;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        return int_value(e->e1, a) && int_value(e->e2, b) ? bool_result(e, a <= b) : e;
+    }
 
-    emit_fetch_int(T1, T1, s);
-    emit_fetch_int(T2, T2, s);
+    // constants are equal if they have the same value, and the string
+    // table has one entry per string.  Int constants compared as objects
+    // are the same object only if both are the constant's own.
+    Expression visit(eq_class *e) {
+        int a, b;
+        bool p, q;
+        e->e1 = fold(e->e1);
+        e->e2 = fold(e->e2);
+        if (int_value(e->e1, a) && int_value(e->e2, b)) {
+            Symbol type = e->e1->get_type();
+            if (type == Int || type == Str || type == Bool) {
+                return bool_result(e, a == b);
+            }
+            return bool_result(e, !is_fresh(e->e1) && !is_fresh(e->e2) &&
+                                  static_cast<int_const_class *>(e->e1)->token ==
+                                  static_cast<int_const_class *>(e->e2)->token);
+        }
+        if (bool_value(e->e1, p) && bool_value(e->e2, q)) {
+            return bool_result(e, p == q);
+        }
+        if (e->e1->get_kind() == string_const_kind && e->e2->get_kind() == string_const_kind) {
+            return bool_result(e, static_cast<string_const_class *>(e->e1)->token ==
+                                  static_cast<string_const_class *>(e->e2)->token);
+        }
+        return e;
+    }
 
-    emit_load_bool(ACC, BoolConst(1), s);
-    emit_blt(T1, T2, label_num, s);
+    Expression visit(comp_class *e) {
+        bool p;
+        e->e1 = fold(e->e1);
+        return bool_value(e->e1, p) ? bool_result(e, !p) : e;
+    }
 
-    emit_load_bool(ACC, BoolConst(0), s);
-    emit_label_def(label_num++, s);
-}
+    Expression visit(isvoid_class *e) {
+        e->e1 = fold(e->e1);
+        return is_constant(e->e1) ? bool_result(e, false) : e;
+    }
 
-void eq_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
+    Expression visit(cond_class *e) {
+        bool p;
+        e->pred = fold(e->pred);
+        if (bool_value(e->pred, p)) {
+            return fold(p ? e->then_exp : e->else_exp)->set_type(e->get_type());
+        }
+        e->then_exp = fold(e->then_exp);
+        e->else_exp = fold(e->else_exp);
+        return e;
+    }
 
-    e2->code(s, env);
+    Expression visit(let_class *e) {
+        e->init = fold(e->init);
+        Expression value = NULL;
+        if (is_constant(e->init) && !is_fresh(e->init) && e->init->get_type() == e->type_decl &&
+            !assigns(e->identifier, e->body)) {
+            value = e->init;
+        }
 
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+        scope.push_back(std::make_pair(e->identifier, value));
+        e->body = fold(e->body);
+        scope.pop_back();
 
-    emit_move(T2, ACC, s);
+        // every use of the variable has been replaced
+        return value ? e->body : e;
+    }
 
-    if (e1->type == Int || e1->type == Str || e1->type == Bool) {
-        emit_load_bool(ACC, BoolConst(1), s);
-        emit_load_bool(A1, BoolConst(0), s);
-        emit_jal("equality_test", s);
-        return;
+    Expression visit(object_class *e) {
+        for (int i = scope.size() - 1; i >= 0; i--) {
+            if (scope[i].first == e->name) {
+                Expression value = scope[i].second;
+                return value ? replace(e, value->copy_Expression()) : e;
+            }
+        }
+        return e;
     }
 
-    emit_load_bool(ACC, BoolConst(1), s);
-    emit_beq(T1, T2, label_num, s);
-    emit_load_bool(ACC, BoolConst(0), s);
-    emit_label_def(label_num++, s);
-}
+    Expression visit(typcase_class *e) {
+        e->expr = fold(e->expr);
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            branch_class *b = static_cast<branch_class *>(e->cases->nth(i));
+            scope.push_back(std::make_pair(b->name, (Expression) NULL));
+            b->expr = fold(b->expr);
+            scope.pop_back();
+        }
+        return e;
+    }
 
-void leq_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_push(ACC, s);
-    env.push_stack_symbol(No_type);
+    Expression visit(assign_class *e) {
+        e->expr = fold(e->expr);
+        return e;
+    }
 
-    e2->code(s, env);
+    Expression visit(static_dispatch_class *e) {
+        e->actual = fold(e->actual);
+        e->expr = fold(e->expr);
+        return e;
+    }
 
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
-    env.pop_stack_symbol();
+    Expression visit(dispatch_class *e) {
+        e->actual = fold(e->actual);
+        e->expr = fold(e->expr);
+        return e;
+    }
 
-    emit_move(T2, ACC, s);
+    Expression visit(loop_class *e) {
+        e->pred = fold(e->pred);
+        e->body = fold(e->body);
+        return e;
+    }
 
-    emit_fetch_int(T1, T1, s);
-    emit_fetch_int(T2, T2, s);
+    Expression visit(block_class *e) {
+        e->body = fold(e->body);
+        return e;
+    }
 
-    emit_load_bool(ACC, BoolConst(1), s);
-    emit_bleq(T1, T2, label_num, s);
+    Expression visit(int_const_class *e)    { return e; }
+    Expression visit(bool_const_class *e)   { return e; }
+    Expression visit(string_const_class *e) { return e; }
+    Expression visit(new__class *e)         { return e; }
+    Expression visit(no_expr_class *e)      { return e; }
+};
 
-    emit_load_bool(ACC, BoolConst(0), s);
-    emit_label_def(label_num++, s);
+static void fold_constants(Classes classes)
+{
+    ConstantFolder folder;
+    for (int i = classes->first(); classes->more(i); i = classes->next(i)) {
+        Features features = classes->nth(i)->get_features();
+        for (int j = features->first(); features->more(j); j = features->next(j)) {
+            Feature f = features->nth(j);
+            if (method_class *m = as_method(f)) {
+                m->expr = folder.fold(m->expr);
+            } else {
+                attr_class *a = as_attr(f);
+                a->init = folder.fold(a->init);
+            }
+        }
+    }
 }
 
-void comp_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_fetch_int(T1, ACC, s);
+//
+// Inlining.  Under -O a call whose method is known at compile time (see
+// overridden_slots) and whose body has at most cgen_inline_size nodes is
+// coded in place, after the arguments are pushed and the receiver is
+// checked for void, as a call would be.  The body is coded in an
+// environment of its own, for the class that defines the method: the
+// arguments on the stack are its formals, and $s0 is set to the receiver
+// for it, unless the receiver is self already.  Afterwards $s0 is put
+// back and the arguments are popped, as the method's epilogue would.
+//
+// Calls in the body may be inlined in turn, up to cgen_inline_depth
+// calls deep.  The body takes temporaries and slots above the caller's,
+// and the caller's frame saves them and has room for them (see
+// begin_frame).
+//
+static int expression_size(Expression e);
 
-    emit_load_bool(ACC, BoolConst(1), s);
+struct SizeCounter {
+    typedef int result_type;
 
-    emit_beq(T1, ZERO, label_num, s);
-    emit_load_bool(ACC, BoolConst(0), s);
+    static int sum(Expressions es) {
+        int n = 0;
+        for (int i = es->first(); es->more(i); i = es->next(i)) {
+            n += expression_size(es->nth(i));
+        }
+        return n;
+    }
 
-    emit_label_def(label_num++, s);
-}
+    int visit(assign_class *e)          { return 1 + expression_size(e->expr); }
+    int visit(static_dispatch_class *e) { return 1 + expression_size(e->expr) + sum(e->actual); }
+    int visit(dispatch_class *e)        { return 1 + expression_size(e->expr) + sum(e->actual); }
+    int visit(cond_class *e)            { return 1 + expression_size(e->pred) + expression_size(e->then_exp) +
+                                                 expression_size(e->else_exp); }
+    int visit(loop_class *e)            { return 1 + expression_size(e->pred) + expression_size(e->body); }
+    int visit(block_class *e)           { return 1 + sum(e->body); }
+    int visit(let_class *e)             { return 1 + expression_size(e->init) + expression_size(e->body); }
+    int visit(plus_class *e)            { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(sub_class *e)             { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(mul_class *e)             { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(divide_class *e)          { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(lt_class *e)              { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(eq_class *e)              { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(leq_class *e)             { return 1 + expression_size(e->e1) + expression_size(e->e2); }
+    int visit(neg_class *e)             { return 1 + expression_size(e->e1); }
+    int visit(comp_class *e)            { return 1 + expression_size(e->e1); }
+    int visit(isvoid_class *e)          { return 1 + expression_size(e->e1); }
+    int visit(int_const_class *e)       { return 1; }
+    int visit(bool_const_class *e)      { return 1; }
+    int visit(string_const_class *e)    { return 1; }
+    int visit(new__class *e)            { return 1; }
+    int visit(no_expr_class *e)         { return 0; }
+    int visit(object_class *e)          { return 1; }
+
+    int visit(typcase_class *e) {
+        int n = 1 + expression_size(e->expr);
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            n += expression_size(e->cases->nth(i)->get_expr());
+        }
+        return n;
+    }
+};
 
-void int_const_class::code(ostream& s, Environment &env) {
-    emit_load_int(ACC,inttable.lookup_string(token->get_string()),s);
+static int expression_size(Expression e)
+{
+    if (e->size < 0) {
+        SizeCounter counter;
+        e->size = visit(e, counter);
+    }
+    return e->size;
 }
 
-void string_const_class::code(ostream& s, Environment &env) {
-    emit_load_string(ACC,stringtable.lookup_string(token->get_string()),s);
+// Is a call of method m, defined in class owner, within the budget?
+static bool fits_inline(Class_ owner, method_class *m, Environment &env)
+{
+    return !is_basic_class(owner->get_name()) && env.get_inline_depth() < cgen_inline_depth &&
+           expression_size(m->expr) <= cgen_inline_size;
 }
 
-void bool_const_class::code(ostream& s, Environment &env) {
-    emit_load_bool(ACC, BoolConst(val), s);
+// Sets up callee for the body of method m, defined in class owner,
+// inlined into code coded in env.
+static void enter_callee(Environment &callee, Class_ owner, method_class *m, Environment &env)
+{
+    callee.set_cls(owner);
+    for (auto attr : owner->all_attrs) {
+        callee.add_cls_attr(attr);
+    }
+    callee.enter_inline(env);
+    Formals formals = m->get_formals();
+    for (int i = formals->first(); formals->more(i); i = formals->next(i)) {
+        callee.push_stack_symbol(formals->nth(i)->get_name());
+    }
 }
 
-void new__class::code(ostream &s, Environment &env) {
-    if (type_name != SELF_TYPE) {
-        emit_load_address(ACC, (char *) (std::string(type_name->get_string()) + PROTOBJ_SUFFIX).c_str(), s);
-        emit_jal("Object.copy", s);
-        emit_jal((char *) (std::string(type_name->get_string()) + CLASSINIT_SUFFIX).c_str(), s);
-        return;
+// Codes the call e of method m, defined in class owner, in place, if it
+// is within the budget; num_params arguments have been pushed and the
+// receiver is in $a0.  Returns false if it is not coded.
+static bool code_inline(dispatch_class *e, Class_ owner, method_class *m, int num_params,
+                        ostream &s, Environment &env)
+{
+    if (!fits_inline(owner, m, env)) {
+        return false;
     }
 
-    emit_load_address(T1, CLASSOBJTAB, s);
-
-    // $t2 = self.tag
-    emit_load(T2, 0, SELF, s);
-    // $t2 = $t2 * 8
-    emit_load_imm(T3, 8, s);
-    emit_mul(T2, T2, T3, s);
-    // $t1 += offset in the CLASSOBJTAB
-    emit_addu(T1, T1, T2, s);
-    // $t1 now points to SELF_TYPE_CLASS_protObj
+    Environment callee;
+    enter_callee(callee, owner, m, env);
 
-    // push $t1 to the stack
-    emit_push(T1, s);
+    bool own_self = e->expr->get_kind() == object_kind &&
+                    static_cast<object_class *>(e->expr)->name == self;
+    int self_slot = -1;
+    if (!own_self) {
+        if (fixed_frames()) {
+            self_slot = callee.alloc_slot();
+            emit_store(env.use_self(), slot_offset(self_slot), env.use_fp(), s);
+        } else {
+            emit_push(env.use_self(), s);
+            callee.push_stack_symbol(No_type);
+        }
+        emit_move(env.use_self(), ACC, s);
+    }
 
-    emit_load(ACC, 0, T1, s);
-    emit_jal("Object.copy", s);
+    m->expr->code(s, callee);
 
-    // pop old pointer from the stack to $t1
-    emit_addiu(SP, SP, 4, s);
-    emit_load(T1, 0, SP, s);
+    if (self_slot >= 0) {
+        emit_load(env.use_self(), slot_offset(self_slot), env.use_fp(), s);
+    } else if (!own_self) {
+        emit_addiu(SP, SP, 4, s);
+        emit_load(env.use_self(), 0, SP, s);
+    }
+    if (num_params > 0) {
+        emit_addiu(SP, SP, 4 * num_params, s);
+    }
+    env.add_temps_used(callee.get_temps_used());
+    env.add_slots_used(callee.get_slots_used());
+    env.add_regs_used(callee);
+    inlined_calls++;
+    return true;
+}
 
-    // $t1 += 1 so it now points to SELF_TYPE_CLASS_init
-    emit_load(T1, 1, T1, s);
-    emit_jalr(T1, s);
+// Does dispatch_class::code code the call e, in code coded in env, as a
+// call?  A direct call is not if it is inlined and the body it inlines
+// makes none (see codes_call), or if it is a tail call (see
+// code_tail_call).
+static bool dispatch_codes_call(dispatch_class *e, Environment &env)
+{
+    if (!cgen_optimize) {
+        return true;
+    }
+    Symbol type = e->expr->get_type();
+    if (type == SELF_TYPE) {
+        type = env.get_cls()->get_name();
+    }
+    int tag = get_class_tag(type);
+    int slot = get_method_slot(type, e->name);
+    if (overridden_slots[tag][slot]) {
+        return true;
+    }
+    const MethodTable::Slot &target = dispatch_tables[tag].nth(slot);
+    bool tail = e->tail && env.get_inline_depth() == 0;
+    if (tail && target.second == env.get_mth()) {
+        return false;
+    }
+    if (fits_inline(target.first, target.second, env)) {
+        Environment callee;
+        enter_callee(callee, target.first, target.second, env);
+        return codes_call(target.second->expr, false, callee);
+    }
+    return !tail;
 }
 
-void isvoid_class::code(ostream &s, Environment &env) {
-    e1->code(s, env);
-    emit_move(T1, ACC, s);
+//
+// Receivers that cannot be void.  An expression is never void if its
+// static type is Int, Bool or String, since values of those types are
+// never void, and otherwise if it is self, a new, a let or case variable
+// that is never void (Environment::is_non_void_var), or a block, if, let,
+// case or assignment whose value is one of those.  A let variable is
+// never void if its initializer is not and it is not assigned to; a case
+// variable, if it is not assigned to.
+//
+struct NonVoid {
+    typedef bool result_type;
 
-    emit_load_bool(ACC, BoolConst(1), s);
+    Environment &env;
 
-    emit_beq(T1, ZERO, label_num, s);
-    emit_load_bool(ACC, BoolConst(0), s);
+    // the let and case variables bound inside the expression, innermost
+    // last, and whether they are never void
+    std::vector<std::pair<Symbol, bool> > scope;
 
-    emit_label_def(label_num++, s);
-}
+    NonVoid(Environment &env) : env(env) { }
 
-void no_expr_class::code(ostream &s, Environment &env) {
-    emit_move(ACC, ZERO, s);
-}
+    bool in(Expression e) {
+        Symbol type = e->get_type();
+        return type == Int || type == Bool || type == Str || ::visit(e, *this);
+    }
 
-void object_class::code(ostream &s, Environment &env) {
-    int pos;
+    bool bound(Symbol name, bool non_void, Expression e) {
+        scope.push_back(std::make_pair(name, non_void));
+        bool result = in(e);
+        scope.pop_back();
+        return result;
+    }
 
-    pos = env.get_let_var_pos_rev(name);
-    if (pos != -1) {
-        emit_load(ACC, pos + 1, SP, s);
-        return;
+    bool visit(object_class *e) {
+        if (e->name == self) {
+            return true;
+        }
+        for (int i = scope.size() - 1; i >= 0; i--) {
+            if (scope[i].first == e->name) {
+                return scope[i].second;
+            }
+        }
+        return env.is_non_void_var(e->name);
     }
 
-    pos = env.get_arg_pos(name);
-    if (pos != -1) {
-        emit_load(ACC, 2 + env.get_mth_args_size() - pos, FP, s);
-        return;
+    bool visit(new__class *e)            { return true; }
+    bool visit(assign_class *e)          { return in(e->expr); }
+    bool visit(cond_class *e)            { return in(e->then_exp) && in(e->else_exp); }
+
+    bool visit(block_class *e) {
+        Expressions body = e->body;
+        int last = body->len() - 1;
+        return in(body->nth(last));
     }
 
-    pos = env.get_cls_attr_pos(name);
-    if (pos != -1) {
-        emit_load(ACC, DEFAULT_OBJFIELDS + pos, SELF, s);
-        return;
+    bool visit(let_class *e) {
+        bool non_void = !e->init->is_empty() && in(e->init) && !assigns(e->identifier, e->body);
+        return bound(e->identifier, non_void, e->body);
     }
 
-    // name == self
-    emit_move(ACC, SELF, s);
+    bool visit(typcase_class *e) {
+        for (int i = e->cases->first(); e->cases->more(i); i = e->cases->next(i)) {
+            Case c = e->cases->nth(i);
+            if (!bound(c->get_name(), !assigns(c->get_name(), c->get_expr()), c->get_expr())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool visit(static_dispatch_class *e) { return false; }
+    bool visit(dispatch_class *e)        { return false; }
+    bool visit(loop_class *e)            { return false; }
+    bool visit(plus_class *e)            { return true; }
+    bool visit(sub_class *e)             { return true; }
+    bool visit(mul_class *e)             { return true; }
+    bool visit(divide_class *e)          { return true; }
+    bool visit(neg_class *e)             { return true; }
+    bool visit(lt_class *e)              { return true; }
+    bool visit(eq_class *e)              { return true; }
+    bool visit(leq_class *e)             { return true; }
+    bool visit(comp_class *e)            { return true; }
+    bool visit(isvoid_class *e)          { return true; }
+    bool visit(int_const_class *e)       { return true; }
+    bool visit(bool_const_class *e)      { return true; }
+    bool visit(string_const_class *e)    { return true; }
+    bool visit(no_expr_class *e)         { return false; }
+};
+
+static bool is_non_void(Expression e, Environment &env)
+{
+    NonVoid analysis(env);
+    return analysis.in(e);
 }
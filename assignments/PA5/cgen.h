@@ -1,9 +1,13 @@
 #include <assert.h>
 #include <stdio.h>
+#include <unordered_map>
 #include <vector>
 #include "emit.h"
+#include "asmbuf.h"
 #include "cool-tree.h"
 #include "symtab.h"
+#include "hierarchy.h"
+#include "methodtab.h"
 
 enum Basicness     {Basic, NotBasic};
 #define TRUE 1
@@ -29,6 +33,7 @@ private:
 
     void code_global_data();
     void code_global_text();
+    void code_heap_start();
     void code_bools(int);
     void code_select_gc();
     void code_constants();
@@ -40,6 +45,7 @@ private:
     void code_prototypes();
     void code_initializers();
     void code_methods();
+    void code_void_dispatch_stubs();
 
     // The following creates an inheritance graph from
     // a list of classes.  The graph is implemented as
@@ -51,6 +57,7 @@ private:
     void install_classes(Classes cs);
     void build_inheritance_tree();
     void set_relations(CgenNodeP nd);
+    void build_layouts();
 public:
     CgenClassTable(Classes, ostream& str);
     void code();
@@ -89,8 +96,51 @@ public:
 class Environment {
     Class_ cls;
     std::vector<attr_class *> cls_attrs;
+    std::unordered_map<Symbol, int> cls_attr_pos;
     std::vector<Formal> mth_args;
+    method_class *mth = NULL;   // the method coded, if any
+    int loop_label = -1;        // start of its body, if it calls itself last
     std::vector<Symbol> stack_symbols;
+    std::vector<Symbol> stack_raw_types;
+    std::vector<bool> stack_non_void;
+
+    // let and case variables held in temporary registers, or under -O in
+    // slots of the frame; depth is the size of stack_symbols when the
+    // variable was bound
+    struct RegSymbol {
+        Symbol name;
+        char *reg;              // NULL if the variable is in a slot
+        int slot;
+        int depth;
+        Symbol raw_type;
+        bool non_void;
+    };
+    std::vector<RegSymbol> reg_symbols;
+    int temps_in_use = 0;
+    int temps_used = 0;         // the most in use at once
+    int raw_temps_in_use = 0;
+    int slots_in_use = 0;
+    int slots_used = 0;         // the most in use at once
+    int inline_depth = 0;       // calls inlined around the code
+    char *self_reg = SELF;      // the register the code keeps self in
+    bool self_used = false;     // self_reg read or written since start_frame()
+    bool fp_used = false;       // $fp, likewise
+
+    // index in reg_symbols of the innermost binding of "name" if that
+    // binding is in a register, or -1
+    int innermost_reg_symbol(Symbol name) {
+        for (int i = reg_symbols.size() - 1; i >= 0; i--) {
+            if (reg_symbols[i].name == name) {
+                for (int j = stack_symbols.size() - 1; j >= reg_symbols[i].depth; j--) {
+                    if (stack_symbols[j] == name) {
+                        return -1;
+                    }
+                }
+                return i;
+            }
+        }
+        return -1;
+    }
 
 public:
     Class_ get_cls() {
@@ -110,6 +160,7 @@ public:
     }
 
     void add_cls_attr(attr_class *attr) {
+        cls_attr_pos[attr->get_name()] = cls_attrs.size();
         cls_attrs.push_back(attr);
     }
 
@@ -121,12 +172,212 @@ public:
         mth_args.clear();
     }
 
-    void push_stack_symbol(Symbol name) {
+    method_class *get_mth() {
+        return mth;
+    }
+
+    void set_mth(method_class *mth) {
+        this->mth = mth;
+        loop_label = -1;
+    }
+
+    int get_loop_label() {
+        return loop_label;
+    }
+
+    void set_loop_label(int label) {
+        loop_label = label;
+    }
+
+    // a raw variable holds the machine word of an Int or Bool, not a
+    // pointer to the object; raw_type is its class, or NULL if it is not
+    // raw.  A non_void variable is known never to be void.
+    void push_stack_symbol(Symbol name, Symbol raw_type = NULL, bool non_void = false) {
         stack_symbols.push_back(name);
+        stack_raw_types.push_back(raw_type);
+        stack_non_void.push_back(non_void);
     }
 
     void pop_stack_symbol() {
         stack_symbols.pop_back();
+        stack_raw_types.pop_back();
+        stack_non_void.pop_back();
+    }
+
+    void push_reg_symbol(Symbol name, char *reg, Symbol raw_type = NULL, bool non_void = false) {
+        RegSymbol r = { name, reg, -1, (int) stack_symbols.size(), raw_type, non_void };
+        reg_symbols.push_back(r);
+    }
+
+    void push_slot_symbol(Symbol name, int slot, Symbol raw_type = NULL, bool non_void = false) {
+        RegSymbol r = { name, NULL, slot, (int) stack_symbols.size(), raw_type, non_void };
+        reg_symbols.push_back(r);
+    }
+
+    void pop_reg_symbol() {
+        reg_symbols.pop_back();
+    }
+
+    // returns the register holding "name" if its innermost binding is in a
+    // register, or NULL
+    char *get_let_var_reg(Symbol name) {
+        int i = innermost_reg_symbol(name);
+        return i < 0 ? NULL : reg_symbols[i].reg;
+    }
+
+    // returns the frame slot holding "name" if its innermost binding is in
+    // a slot, or -1
+    int get_let_var_slot(Symbol name) {
+        int i = innermost_reg_symbol(name);
+        return i < 0 ? -1 : reg_symbols[i].slot;
+    }
+
+    // the class of "name" if its innermost binding is a raw let
+    // variable, or NULL
+    Symbol get_raw_let_var_type(Symbol name) {
+        int i = innermost_reg_symbol(name);
+        if (i >= 0) {
+            return reg_symbols[i].raw_type;
+        }
+        i = get_let_var_pos_rev(name);
+        return i < 0 ? NULL : stack_raw_types[stack_raw_types.size() - 1 - i];
+    }
+
+    bool is_raw_let_var(Symbol name) {
+        return get_raw_let_var_type(name) != NULL;
+    }
+
+    // is the innermost binding of "name" a let or case variable that is
+    // never void?
+    bool is_non_void_var(Symbol name) {
+        int i = innermost_reg_symbol(name);
+        if (i >= 0) {
+            return reg_symbols[i].non_void;
+        }
+        i = get_let_var_pos_rev(name);
+        return i >= 0 && stack_non_void[stack_non_void.size() - 1 - i];
+    }
+
+    // temporary registers are taken and released in stack order; the
+    // number returned indexes temp_regs in cgen.cc
+    int alloc_temp() {
+        if (temps_in_use == temps_used) {
+            temps_used++;
+        }
+        return temps_in_use++;
+    }
+
+    void free_temp() {
+        temps_in_use--;
+    }
+
+    int get_temps_in_use() {
+        return temps_in_use;
+    }
+
+    // the most temporaries in use at once since reset_temps_used(),
+    // including in inlined calls
+    int get_temps_used() {
+        return temps_used;
+    }
+
+    void reset_temps_used() {
+        temps_used = temps_in_use;
+        slots_used = slots_in_use;
+    }
+
+    void add_temps_used(int used) {
+        if (used > temps_used) {
+            temps_used = used;
+        }
+    }
+
+    // Starts the code of a frame that keeps self in self_reg.  The frame
+    // saves $fp and $s0 only if the code asks for them (see end_frame in
+    // cgen.cc), so code goes through use_self() and use_fp() for them.
+    void start_frame(char *self_reg) {
+        this->self_reg = self_reg;
+        self_used = fp_used = false;
+    }
+
+    char *use_self() {
+        self_used = true;
+        return self_reg;
+    }
+
+    char *use_fp() {
+        fp_used = true;
+        return FP;
+    }
+
+    bool uses_self() {
+        return self_used;
+    }
+
+    bool uses_fp() {
+        return fp_used;
+    }
+
+    // the registers used by a call inlined into the code
+    void add_regs_used(Environment &callee) {
+        self_used = self_used || callee.self_used;
+        fp_used = fp_used || callee.fp_used;
+    }
+
+    // Starts the environment of a call inlined into code coded in caller:
+    // the caller's temporaries stay taken, and none of its names are seen.
+    void enter_inline(Environment &caller) {
+        temps_in_use = temps_used = caller.temps_in_use;
+        slots_in_use = slots_used = caller.slots_in_use;
+        raw_temps_in_use = caller.raw_temps_in_use;
+        inline_depth = caller.inline_depth + 1;
+        self_reg = caller.self_reg;
+    }
+
+    int get_inline_depth() {
+        return inline_depth;
+    }
+
+    // frame slots are taken and released in stack order as well; slot i
+    // is the (i + 1)th word below $fp
+    int alloc_slot() {
+        if (slots_in_use == slots_used) {
+            slots_used++;
+        }
+        return slots_in_use++;
+    }
+
+    void free_slot() {
+        slots_in_use--;
+    }
+
+    int get_slots_in_use() {
+        return slots_in_use;
+    }
+
+    // the most slots in use at once since reset_temps_used(), including
+    // in inlined calls
+    int get_slots_used() {
+        return slots_used;
+    }
+
+    void add_slots_used(int used) {
+        if (used > slots_used) {
+            slots_used = used;
+        }
+    }
+
+    // the same for T5 and T6; the number indexes raw_temp_regs in cgen.cc
+    int alloc_raw_temp() {
+        return raw_temps_in_use++;
+    }
+
+    void free_raw_temp() {
+        raw_temps_in_use--;
+    }
+
+    int get_raw_temps_in_use() {
+        return raw_temps_in_use;
     }
 
     // returns symbol's position from the END of the vector or -1 if not found
@@ -155,11 +406,7 @@ public:
 
     // returns attribute's position on the vector (starting from 0) or -1 if not found
     int get_cls_attr_pos(Symbol name) {
-        for (int i = 0; i < (int) cls_attrs.size(); i++) {
-            if (cls_attrs[i]->get_name() == name) {
-                return i;
-            }
-        }
-        return -1;
+        auto it = cls_attr_pos.find(name);
+        return it == cls_attr_pos.end() ? -1 : it->second;
     }
 };
@@ -13,16 +13,39 @@
 #include "tree.h"
 #include "cool-tree.handcode.h"
 
+#include "symtab.h"
+typedef SymbolTable<Symbol, Symbol> object_env;
+
+struct type_env {
+    object_env o;
+    Class_ c;
+};
+
+// The constructor that made a node.  Every phylum carries its kind so
+// that code can tell, say, a method from an attribute without RTTI.
+enum node_kind : unsigned char {
+   program_kind, class__kind, method_kind, attr_kind, formal_kind,
+   branch_kind, assign_kind, static_dispatch_kind, dispatch_kind,
+   cond_kind, loop_kind, typcase_kind, block_kind, let_kind, plus_kind,
+   sub_kind, mul_kind, divide_kind, neg_kind, lt_kind, eq_kind, leq_kind,
+   comp_kind, int_const_kind, bool_const_kind, string_const_kind,
+   new__kind, isvoid_kind, no_expr_kind, object_kind
+};
 
 // define the class for phylum
 // define simple phylum - Program
 typedef class Program_class *Program;
 
 class Program_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()		 { return kind; }
    tree_node *copy()		 { return copy_Program(); }
    virtual Program copy_Program() = 0;
 
+   virtual void check() = 0;
+
 #ifdef Program_EXTRAS
    Program_EXTRAS
 #endif
@@ -35,14 +58,17 @@ class attr_class;
 typedef class Class__class *Class_;
 
 class Class__class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
-   std::vector<std::pair<Class_, method_class *> > all_methods;
+   node_kind get_kind()		 { return kind; }
    std::vector<attr_class *> all_attrs;
 
    tree_node *copy()		 { return copy_Class_(); }
    virtual Class_ copy_Class_() = 0;
 
    virtual Features get_features() = 0;
+   virtual void check() = 0;
 
 #ifdef Class__EXTRAS
    Class__EXTRAS
@@ -54,11 +80,16 @@ public:
 typedef class Feature_class *Feature;
 
 class Feature_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()		 { return kind; }
    tree_node *copy()		 { return copy_Feature(); }
    virtual Feature copy_Feature() = 0;
 
    virtual Symbol get_name() = 0;
+   virtual Symbol typecheck(type_env &tenv) = 0;
+
 #ifdef Feature_EXTRAS
    Feature_EXTRAS
 #endif
@@ -69,11 +100,15 @@ public:
 typedef class Formal_class *Formal;
 
 class Formal_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()		 { return kind; }
    tree_node *copy()		 { return copy_Formal(); }
    virtual Formal copy_Formal() = 0;
 
    virtual Symbol get_name() = 0;
+   virtual Symbol get_type_decl() = 0;
 
 #ifdef Formal_EXTRAS
    Formal_EXTRAS
@@ -85,7 +120,10 @@ public:
 typedef class Expression_class *Expression;
 
 class Expression_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()		 { return kind; }
    tree_node *copy()		 { return copy_Expression(); }
    virtual Expression copy_Expression() = 0;
 
@@ -93,6 +131,8 @@ public:
        return false;
    }
 
+   virtual Symbol typecheck(type_env &tenv) = 0;
+
 #ifdef Expression_EXTRAS
    Expression_EXTRAS
 #endif
@@ -103,7 +143,10 @@ public:
 typedef class Case_class *Case;
 
 class Case_class : public tree_node {
+protected:
+   node_kind kind;             // set by the constructor
 public:
+   node_kind get_kind()		 { return kind; }
    tree_node *copy()		 { return copy_Case(); }
    virtual Case copy_Case() = 0;
 
@@ -150,11 +193,14 @@ public:
    Classes classes;
 public:
    program_class(Classes a1) {
+      kind = program_kind;
       classes = a1;
    }
    Program copy_Program();
    void dump(ostream& stream, int n);
 
+   void check();
+
 #ifdef Program_SHARED_EXTRAS
    Program_SHARED_EXTRAS
 #endif
@@ -173,6 +219,7 @@ public:
    Symbol filename;
 public:
    class__class(Symbol a1, Symbol a2, Features a3, Symbol a4) {
+      kind = class__kind;
       name = a1;
       parent = a2;
       features = a3;
@@ -185,6 +232,8 @@ public:
        return features;
    }
 
+   void check();
+
 #ifdef Class__SHARED_EXTRAS
    Class__SHARED_EXTRAS
 #endif
@@ -203,6 +252,7 @@ public:
    Expression expr;
 public:
    method_class(Symbol a1, Formals a2, Symbol a3, Expression a4) {
+      kind = method_kind;
       name = a1;
       formals = a2;
       return_type = a3;
@@ -217,6 +267,16 @@ public:
 
    void code(ostream &, Environment &);
 
+   Formals get_formals() {
+       return formals;
+   }
+
+   Symbol get_return_type() {
+       return return_type;
+   }
+
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Feature_SHARED_EXTRAS
    Feature_SHARED_EXTRAS
 #endif
@@ -234,6 +294,7 @@ public:
    Expression init;
 public:
    attr_class(Symbol a1, Symbol a2, Expression a3) {
+      kind = attr_kind;
       name = a1;
       type_decl = a2;
       init = a3;
@@ -253,6 +314,8 @@ public:
        return init;
    }
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Feature_SHARED_EXTRAS
    Feature_SHARED_EXTRAS
 #endif
@@ -269,6 +332,7 @@ public:
    Symbol type_decl;
 public:
    formal_class(Symbol a1, Symbol a2) {
+      kind = formal_kind;
       name = a1;
       type_decl = a2;
    }
@@ -279,6 +343,10 @@ public:
        return name;
    }
 
+   Symbol get_type_decl() {
+       return type_decl;
+   }
+
 #ifdef Formal_SHARED_EXTRAS
    Formal_SHARED_EXTRAS
 #endif
@@ -296,6 +364,7 @@ public:
    Expression expr;
 public:
    branch_class(Symbol a1, Symbol a2, Expression a3) {
+      kind = branch_kind;
       name = a1;
       type_decl = a2;
       expr = a3;
@@ -331,12 +400,19 @@ public:
    Expression expr;
 public:
    assign_class(Symbol a1, Expression a2) {
+      kind = assign_kind;
       name = a1;
       expr = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol get_name() {
+       return name;
+   }
+
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -355,6 +431,7 @@ public:
    Expressions actual;
 public:
    static_dispatch_class(Expression a1, Symbol a2, Symbol a3, Expressions a4) {
+      kind = static_dispatch_kind;
       expr = a1;
       type_name = a2;
       name = a3;
@@ -363,6 +440,8 @@ public:
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -380,6 +459,7 @@ public:
    Expressions actual;
 public:
    dispatch_class(Expression a1, Symbol a2, Expressions a3) {
+      kind = dispatch_kind;
       expr = a1;
       name = a2;
       actual = a3;
@@ -387,6 +467,8 @@ public:
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -404,6 +486,7 @@ public:
    Expression else_exp;
 public:
    cond_class(Expression a1, Expression a2, Expression a3) {
+      kind = cond_kind;
       pred = a1;
       then_exp = a2;
       else_exp = a3;
@@ -411,6 +494,8 @@ public:
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -427,12 +512,15 @@ public:
    Expression body;
 public:
    loop_class(Expression a1, Expression a2) {
+      kind = loop_kind;
       pred = a1;
       body = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -449,12 +537,15 @@ public:
    Cases cases;
 public:
    typcase_class(Expression a1, Cases a2) {
+      kind = typcase_kind;
       expr = a1;
       cases = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -470,11 +561,14 @@ public:
    Expressions body;
 public:
    block_class(Expressions a1) {
+      kind = block_kind;
       body = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -493,6 +587,7 @@ public:
    Expression body;
 public:
    let_class(Symbol a1, Symbol a2, Expression a3, Expression a4) {
+      kind = let_kind;
       identifier = a1;
       type_decl = a2;
       init = a3;
@@ -501,6 +596,8 @@ public:
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -517,12 +614,15 @@ public:
    Expression e2;
 public:
    plus_class(Expression a1, Expression a2) {
+      kind = plus_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -539,12 +639,15 @@ public:
    Expression e2;
 public:
    sub_class(Expression a1, Expression a2) {
+      kind = sub_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -561,12 +664,15 @@ public:
    Expression e2;
 public:
    mul_class(Expression a1, Expression a2) {
+      kind = mul_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -583,12 +689,15 @@ public:
    Expression e2;
 public:
    divide_class(Expression a1, Expression a2) {
+      kind = divide_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -604,11 +713,14 @@ public:
    Expression e1;
 public:
    neg_class(Expression a1) {
+      kind = neg_kind;
       e1 = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -625,12 +737,15 @@ public:
    Expression e2;
 public:
    lt_class(Expression a1, Expression a2) {
+      kind = lt_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -647,12 +762,15 @@ public:
    Expression e2;
 public:
    eq_class(Expression a1, Expression a2) {
+      kind = eq_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -669,12 +787,15 @@ public:
    Expression e2;
 public:
    leq_class(Expression a1, Expression a2) {
+      kind = leq_kind;
       e1 = a1;
       e2 = a2;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -690,11 +811,14 @@ public:
    Expression e1;
 public:
    comp_class(Expression a1) {
+      kind = comp_kind;
       e1 = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -710,11 +834,14 @@ public:
    Symbol token;
 public:
    int_const_class(Symbol a1) {
+      kind = int_const_kind;
       token = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -730,11 +857,14 @@ public:
    Boolean val;
 public:
    bool_const_class(Boolean a1) {
+      kind = bool_const_kind;
       val = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -750,11 +880,14 @@ public:
    Symbol token;
 public:
    string_const_class(Symbol a1) {
+      kind = string_const_kind;
       token = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -770,11 +903,14 @@ public:
    Symbol type_name;
 public:
    new__class(Symbol a1) {
+      kind = new__kind;
       type_name = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -790,11 +926,14 @@ public:
    Expression e1;
 public:
    isvoid_class(Expression a1) {
+      kind = isvoid_kind;
       e1 = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -809,6 +948,7 @@ class no_expr_class : public Expression_class {
 public:
 public:
    no_expr_class() {
+      kind = no_expr_kind;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
@@ -817,6 +957,8 @@ public:
        return true;
    }
 
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -832,11 +974,18 @@ public:
    Symbol name;
 public:
    object_class(Symbol a1) {
+      kind = object_kind;
       name = a1;
    }
    Expression copy_Expression();
    void dump(ostream& stream, int n);
 
+   Symbol get_name() {
+       return name;
+   }
+
+   Symbol typecheck(type_env &tenv);
+
 #ifdef Expression_SHARED_EXTRAS
    Expression_SHARED_EXTRAS
 #endif
@@ -846,6 +995,67 @@ public:
 };
 
 
+//
+// Checked downcasts and visitors that go by a node's kind.
+//
+//   as_method(f), as_attr(f)
+//      f as a method_class or attr_class, or NULL if it is the other.
+//
+//   visit(f, v), visit(e, v)
+//      call v.visit(n), where n is the feature f or expression e cast
+//      to the class of its constructor, and return the result.  V must
+//      define visit for each of those classes and a result_type.
+//
+inline method_class *as_method(Feature f)
+{
+   return f->get_kind() == method_kind ? static_cast<method_class *>(f) : NULL;
+}
+
+inline attr_class *as_attr(Feature f)
+{
+   return f->get_kind() == attr_kind ? static_cast<attr_class *>(f) : NULL;
+}
+
+template <class V> typename V::result_type visit(Feature f, V &v)
+{
+   if (f->get_kind() == method_kind)
+      return v.visit(static_cast<method_class *>(f));
+   else
+      return v.visit(static_cast<attr_class *>(f));
+}
+
+template <class V> typename V::result_type visit(Expression e, V &v)
+{
+   switch (e->get_kind()) {
+   case assign_kind:           return v.visit(static_cast<assign_class *>(e));
+   case static_dispatch_kind:  return v.visit(static_cast<static_dispatch_class *>(e));
+   case dispatch_kind:         return v.visit(static_cast<dispatch_class *>(e));
+   case cond_kind:             return v.visit(static_cast<cond_class *>(e));
+   case loop_kind:             return v.visit(static_cast<loop_class *>(e));
+   case typcase_kind:          return v.visit(static_cast<typcase_class *>(e));
+   case block_kind:            return v.visit(static_cast<block_class *>(e));
+   case let_kind:              return v.visit(static_cast<let_class *>(e));
+   case plus_kind:             return v.visit(static_cast<plus_class *>(e));
+   case sub_kind:              return v.visit(static_cast<sub_class *>(e));
+   case mul_kind:              return v.visit(static_cast<mul_class *>(e));
+   case divide_kind:           return v.visit(static_cast<divide_class *>(e));
+   case neg_kind:              return v.visit(static_cast<neg_class *>(e));
+   case lt_kind:               return v.visit(static_cast<lt_class *>(e));
+   case eq_kind:               return v.visit(static_cast<eq_class *>(e));
+   case leq_kind:              return v.visit(static_cast<leq_class *>(e));
+   case comp_kind:             return v.visit(static_cast<comp_class *>(e));
+   case int_const_kind:        return v.visit(static_cast<int_const_class *>(e));
+   case bool_const_kind:       return v.visit(static_cast<bool_const_class *>(e));
+   case string_const_kind:     return v.visit(static_cast<string_const_class *>(e));
+   case new__kind:             return v.visit(static_cast<new__class *>(e));
+   case isvoid_kind:           return v.visit(static_cast<isvoid_class *>(e));
+   case no_expr_kind:          return v.visit(static_cast<no_expr_class *>(e));
+   default:
+      return v.visit(static_cast<object_class *>(e));
+   }
+}
+
+
 // define the prototypes of the interface
 Classes nil_Classes();
 Classes single_Classes(Class_);
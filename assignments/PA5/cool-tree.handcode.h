@@ -9,6 +9,8 @@
 #include "cool.h"
 #include "stringtab.h"
 
+class BinaryWriter;
+
 #define yylineno curr_lineno;
 extern int yylineno;
 
@@ -48,65 +50,86 @@ typedef list_node<Case> Cases_class;
 typedef Cases_class *Cases;
 
 #define Program_EXTRAS                          \
+virtual void semant() = 0;			\
 virtual void cgen(ostream&) = 0;		\
-virtual void dump_with_types(ostream&, int) = 0;
+virtual void dump_with_types(ostream&, int) = 0; \
+virtual void dump_binary(BinaryWriter&) = 0;
 
 
 
 #define program_EXTRAS                          \
+void semant();     				\
 void cgen(ostream&);     			\
-void dump_with_types(ostream&, int);
+void dump_with_types(ostream&, int);    \
+void dump_binary(BinaryWriter&);
 
 #define Class__EXTRAS                   \
 virtual Symbol get_name() = 0;  	\
 virtual Symbol get_parent() = 0;    	\
 virtual Symbol get_filename() = 0;      \
-virtual void dump_with_types(ostream&,int) = 0;
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(BinaryWriter&) = 0;
 
 
 #define class__EXTRAS                                  \
 Symbol get_name()   { return name; }		       \
 Symbol get_parent() { return parent; }     	       \
 Symbol get_filename() { return filename; }             \
-void dump_with_types(ostream&,int);
+void dump_with_types(ostream&,int);     \
+void dump_binary(BinaryWriter&);
 
 
 #define Feature_EXTRAS                                        \
-virtual void dump_with_types(ostream&,int) = 0;
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(BinaryWriter&) = 0;
 
 
 #define Feature_SHARED_EXTRAS                                       \
-void dump_with_types(ostream&,int);
+void dump_with_types(ostream&,int);     \
+void dump_binary(BinaryWriter&);
 
 
 #define Formal_EXTRAS                              \
-virtual void dump_with_types(ostream&,int) = 0;
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(BinaryWriter&) = 0;
 
 
 #define formal_EXTRAS                           \
-void dump_with_types(ostream&,int);
+void dump_with_types(ostream&,int);     \
+void dump_binary(BinaryWriter&);
 
 
 #define Case_EXTRAS                             \
-virtual void dump_with_types(ostream& ,int) = 0;
+virtual void dump_with_types(ostream& ,int) = 0; \
+virtual void dump_binary(BinaryWriter&) = 0;
 
 
 #define branch_EXTRAS                                   \
-void dump_with_types(ostream& ,int);
+void dump_with_types(ostream& ,int);    \
+void dump_binary(BinaryWriter&);
 
 
 #define Expression_EXTRAS                    \
 Symbol type;                                 \
+int temps;      /* registers code() needs; -1 until counted */ \
+int calls;      /* 1 if code() may call a method; -1 until known */ \
+int size;       /* nodes in the expression's tree; -1 until counted */ \
+bool tail;      /* a call its method makes last (see mark_tail_calls) */ \
 Symbol get_type() { return type; }           \
 Expression set_type(Symbol s) { type = s; return this; } \
 virtual void code(ostream&, Environment &) = 0; \
 virtual void dump_with_types(ostream&,int) = 0;  \
+virtual void dump_binary(BinaryWriter&) = 0;     \
 void dump_type(ostream&, int);               \
-Expression_class() { type = (Symbol) NULL; }
+Expression_class() { type = (Symbol) NULL; temps = -1; calls = -1; size = -1; tail = false; }
 
 #define Expression_SHARED_EXTRAS           \
 void code(ostream&, Environment &); 			   \
-void dump_with_types(ostream&,int);
+void dump_with_types(ostream&,int);     \
+void dump_binary(BinaryWriter&);
+
+#define int_const_EXTRAS                     \
+bool fresh = false; /* folded arithmetic: a new Int (see ConstantFolder) */
 
 
 #endif
@@ -36,6 +36,7 @@
 #define INTCONST_PREFIX      "int_const"
 #define STRCONST_PREFIX      "str_const"
 #define BOOLCONST_PREFIX     "bool_const"
+#define VOID_DISPATCH_PREFIX "void_dispatch"
 
 
 #define EMPTYSLOT            0
@@ -74,6 +75,20 @@
 #define T1   "$t1"		// Temporary 1
 #define T2   "$t2"		// Temporary 2
 #define T3   "$t3"		// Temporary 3
+#define T4   "$t4"		// Self in a body that makes no calls
+#define S1   "$s1"		// Temporaries held across calls (callee saves);
+#define S2   "$s2"		// the garbage collector updates them, and the
+#define S3   "$s3"		// runtime system does not touch them
+#define S4   "$s4"
+#define S5   "$s5"
+#define S6   "$s6"
+#define NUM_TEMPS 6
+#define T5   "$t5"		// Untagged values held across allocation: the
+#define T6   "$t6"		// runtime system does not touch these and the
+#define T7   "$t7"		// collector does not scan them
+#define NUM_RAW_TEMPS 2 	// T5 and T6; T7 is used for boxing
+#define GP   "$gp"		// Heap pointer, which allocation bumps up
+#define S7   "$s7"		// to this limit
 #define SP   "$sp"		// Stack pointer
 #define FP   "$fp"		// Frame pointer
 #define RA   "$ra"		// Return address
@@ -84,6 +99,8 @@
 #define JALR  "\tjalr\t"
 #define JAL   "\tjal\t"
 #define RET   "\tjr\t"RA"\t"
+#define JR    "\tjr\t"
+#define JUMP  "\tj\t"
 
 #define SW    "\tsw\t"
 #define LW    "\tlw\t"
@@ -100,6 +117,12 @@
 #define MUL   "\tmul\t"
 #define SUB   "\tsub\t"
 #define SLL   "\tsll\t"
+#define SRA   "\tsra\t"
+#define SRL   "\tsrl\t"
+#define SLT   "\tslt\t"
+#define SLTIU "\tsltiu\t"
+#define SEQ   "\tseq\t"
+#define XORI  "\txori\t"
 #define BEQZ  "\tbeqz\t"
 #define BRANCH   "\tb\t"
 #define BEQ      "\tbeq\t"
@@ -0,0 +1,491 @@
+//
+// Peephole optimization of the code of one method (see peephole.h).
+//
+// The buffered text is split into instructions, which are rewritten by
+// a few passes, repeated while they find something, and written out
+// again.  An instruction that is not rewritten is written exactly as it
+// was generated.
+//
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "peephole.h"
+
+enum Pattern {
+    PUSH_POP,
+    LOAD_AFTER_STORE,
+    REPEATED_LOAD,
+    BRANCH_CHAIN,
+    BRANCH_TO_NEXT,
+    SELF_MOVE,
+    DEAD_MOVE,
+    NUM_PATTERNS
+};
+
+static const char *pattern_names[NUM_PATTERNS] = {
+    "push/pop forwarded",
+    "load after store",
+    "repeated load",
+    "branch to branch",
+    "branch to next",
+    "move to itself",
+    "dead move",
+};
+
+static long hits[NUM_PATTERNS];
+
+namespace {
+
+enum Kind {
+    LABEL_LINE,      // "name:"
+    COMPUTE,         // writes its first operand, reads the others
+    LOAD,            // lw; writes its first operand, reads the base
+    STORE,           // sw
+    BRANCH,          // conditional or not; the target is the last operand
+    OTHER            // anything else: calls, jumps, returns, directives
+};
+
+struct Insn {
+    std::string line;                   // as generated, without the newline
+    Kind kind;
+    std::string op;
+    std::vector<std::string> args;
+    bool deleted;
+    bool changed;                       // write op and args, not line
+
+    std::string label() const           { return line.substr(0, line.size() - 1); }
+    std::string target() const          { return args.back(); }
+};
+
+const char *compute_ops[] = {
+    "li", "la", "move", "add", "addu", "addi", "addiu", "sub", "subu", "mul",
+    "div", "rem", "neg", "not", "sll", "srl", "sra", "slt", "sltu", "slti",
+    "seq", "sne", "sgt", "and", "andi", "or", "ori", "xor", "xori", "nor",
+    "lb", NULL
+};
+
+const char *branch_ops[] = {
+    "b", "beq", "bne", "blt", "ble", "bgt", "bge", "beqz", "bnez", NULL
+};
+
+bool one_of(const std::string &op, const char **ops)
+{
+    for (; *ops; ops++) {
+        if (op == *ops) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Insn parse(const std::string &line)
+{
+    Insn insn;
+    insn.line = line;
+    insn.deleted = false;
+    insn.changed = false;
+    insn.kind = OTHER;
+
+    if (!line.empty() && line[0] != '\t' && line[line.size() - 1] == ':') {
+        insn.kind = LABEL_LINE;
+        return insn;
+    }
+    if (line.empty() || line[0] != '\t') {
+        return insn;
+    }
+
+    size_t i = 0;
+    while (true) {
+        i = line.find_first_not_of(" \t", i);
+        if (i == std::string::npos) {
+            break;
+        }
+        size_t j = line.find_first_of(" \t", i);
+        std::string word = line.substr(i, j == std::string::npos ? std::string::npos : j - i);
+        if (insn.op.empty()) {
+            insn.op = word;
+        } else {
+            insn.args.push_back(word);
+        }
+        i = j;
+    }
+
+    if (insn.op == "lw" && insn.args.size() == 2) {
+        insn.kind = LOAD;
+    } else if (insn.op == "sw" && insn.args.size() == 2) {
+        insn.kind = STORE;
+    } else if (one_of(insn.op, compute_ops) && !insn.args.empty()) {
+        insn.kind = COMPUTE;
+    } else if (one_of(insn.op, branch_ops) && !insn.args.empty()) {
+        insn.kind = BRANCH;
+    }
+    return insn;
+}
+
+// Makes insn "move a b".
+void set_move(Insn &insn, const std::string &a, const std::string &b)
+{
+    insn.kind = COMPUTE;
+    insn.op = "move";
+    insn.args.clear();
+    insn.args.push_back(a);
+    insn.args.push_back(b);
+    insn.changed = true;
+}
+
+// Splits a memory operand "off(base)".
+bool address(const std::string &arg, std::string &off, std::string &base)
+{
+    size_t open = arg.find('(');
+    if (open == std::string::npos || arg[arg.size() - 1] != ')') {
+        return false;
+    }
+    off = arg.substr(0, open);
+    base = arg.substr(open + 1, arg.size() - open - 2);
+    return true;
+}
+
+bool mentions(const std::string &arg, const std::string &reg)
+{
+    if (arg == reg) {
+        return true;
+    }
+    std::string off, base;
+    return address(arg, off, base) && base == reg;
+}
+
+// The register an instruction writes, or "".
+std::string written(const Insn &insn)
+{
+    return insn.kind == COMPUTE || insn.kind == LOAD ? insn.args[0] : "";
+}
+
+// Does an instruction read reg?  Calls, jumps and anything not known
+// are taken to read everything.
+bool reads(const Insn &insn, const std::string &reg)
+{
+    size_t first;
+    switch (insn.kind) {
+    case COMPUTE:
+    case LOAD:
+        first = 1;
+        break;
+    case STORE:
+    case BRANCH:
+        first = 0;
+        break;
+    default:
+        return true;
+    }
+    for (size_t i = first; i < insn.args.size(); i++) {
+        if (mentions(insn.args[i], reg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool is_sp_adjust(const Insn &insn, const char *amount)
+{
+    return insn.op == "addiu" && insn.args.size() == 3 && insn.args[0] == "$sp" &&
+           insn.args[1] == "$sp" && insn.args[2] == amount;
+}
+
+class Peephole {
+    std::vector<Insn> code;
+    std::unordered_map<std::string, int> labels;   // label to index
+
+    // the next instruction after i that has not been deleted, or code.size()
+    int next(int i) {
+        do {
+            i++;
+        } while (i < (int) code.size() && code[i].deleted);
+        return i;
+    }
+
+    // sw X 0($sp); addiu $sp $sp -4; ...; addiu $sp $sp 4; lw Y 0($sp)
+    // with nothing in between that uses $sp or leaves the block.  If X is
+    // written in between, Y is set from X where X was pushed, so Y may
+    // not be used in between either.
+    bool forward_push_pop(int i) {
+        Insn &push = code[i];
+        if (push.kind != STORE || push.args[1] != "0($sp)") {
+            return false;
+        }
+        int adjust = next(i);
+        if (adjust == (int) code.size() || !is_sp_adjust(code[adjust], "-4")) {
+            return false;
+        }
+        std::string x = push.args[0];
+        bool x_written = false;
+        std::vector<int> between;
+        for (int j = next(adjust); j < (int) code.size(); j = next(j)) {
+            Insn &insn = code[j];
+            if (is_sp_adjust(insn, "4")) {
+                int k = next(j);
+                if (k == (int) code.size() || code[k].kind != LOAD || code[k].args[1] != "0($sp)") {
+                    return false;
+                }
+                std::string y = code[k].args[0];
+                bool y_used = false;
+                for (size_t b = 0; b < between.size(); b++) {
+                    for (size_t a = 0; a < code[between[b]].args.size(); a++) {
+                        y_used |= mentions(code[between[b]].args[a], y);
+                    }
+                }
+                if (x_written && (y_used || y == x)) {
+                    return false;
+                }
+                code[adjust].deleted = insn.deleted = true;
+                if (x_written) {
+                    set_move(push, y, x);
+                    code[k].deleted = true;
+                } else {
+                    push.deleted = true;
+                    if (y == x) {
+                        code[k].deleted = true;
+                    } else {
+                        set_move(code[k], y, x);
+                    }
+                }
+                hits[PUSH_POP]++;
+                return true;
+            }
+            if (insn.kind != COMPUTE && insn.kind != LOAD && insn.kind != STORE) {
+                return false;
+            }
+            for (size_t a = 0; a < insn.args.size(); a++) {
+                if (mentions(insn.args[a], "$sp")) {
+                    return false;
+                }
+            }
+            if (written(insn) == x) {
+                x_written = true;
+            }
+            between.push_back(j);
+        }
+        return false;
+    }
+
+    // A register known to hold a word of memory.
+    struct Known {
+        std::string reg, off, base;
+    };
+
+    bool eliminate_loads() {
+        bool found = false;
+        std::vector<Known> known;
+
+        for (int i = 0; i < (int) code.size(); i++) {
+            Insn &insn = code[i];
+            std::string off, base;
+            if (insn.deleted || insn.kind == BRANCH) {
+                continue;
+            }
+            if (insn.kind == LABEL_LINE || insn.kind == OTHER ||
+                (insn.kind == STORE && !address(insn.args[1], off, base))) {
+                known.clear();
+                continue;
+            }
+
+            if (insn.kind == STORE) {
+                // the store may change any word but the others off base
+                for (size_t k = 0; k < known.size(); ) {
+                    if (known[k].base != base || known[k].off == off) {
+                        known.erase(known.begin() + k);
+                    } else {
+                        k++;
+                    }
+                }
+                if (insn.args[0] != base) {
+                    Known k = { insn.args[0], off, base };
+                    known.push_back(k);
+                }
+                continue;
+            }
+
+            std::string dest = written(insn);
+            bool load = insn.kind == LOAD && address(insn.args[1], off, base);
+            if (load) {
+                for (size_t k = 0; k < known.size(); k++) {
+                    if (known[k].off == off && known[k].base == base) {
+                        hits[known[k].reg == dest ? REPEATED_LOAD : LOAD_AFTER_STORE]++;
+                        found = true;
+                        if (known[k].reg == dest) {
+                            insn.deleted = true;
+                        } else {
+                            set_move(insn, dest, known[k].reg);
+                        }
+                        break;
+                    }
+                }
+                if (insn.deleted) {
+                    continue;
+                }
+            }
+
+            for (size_t k = 0; k < known.size(); ) {
+                if (known[k].reg == dest || known[k].base == dest) {
+                    known.erase(known.begin() + k);
+                } else {
+                    k++;
+                }
+            }
+            if (load && dest != base) {
+                Known k = { dest, off, base };
+                known.push_back(k);
+            }
+        }
+        return found;
+    }
+
+    // the label a branch to "label" ends up at, following branches
+    std::string final_target(std::string label) {
+        for (int hops = 0; hops < 8; hops++) {
+            std::unordered_map<std::string, int>::iterator it = labels.find(label);
+            if (it == labels.end()) {
+                break;
+            }
+            int i = it->second;
+            while (i < (int) code.size() && (code[i].deleted || code[i].kind == LABEL_LINE)) {
+                i++;
+            }
+            if (i == (int) code.size() || code[i].kind != BRANCH || code[i].op != "b" ||
+                code[i].target() == label) {
+                break;
+            }
+            label = code[i].target();
+        }
+        return label;
+    }
+
+    bool chain_branches() {
+        bool found = false;
+        for (int i = 0; i < (int) code.size(); i++) {
+            Insn &insn = code[i];
+            if (insn.deleted || insn.kind != BRANCH) {
+                continue;
+            }
+            std::string target = final_target(insn.target());
+            if (target != insn.target()) {
+                insn.args.back() = target;
+                insn.changed = true;
+                hits[BRANCH_CHAIN]++;
+                found = true;
+            }
+
+            // a branch to a label right after it goes either way to the
+            // same place
+            for (int j = next(i); j < (int) code.size() && code[j].kind == LABEL_LINE; j = next(j)) {
+                if (code[j].label() == target) {
+                    insn.deleted = true;
+                    hits[BRANCH_TO_NEXT]++;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+
+    bool remove_moves() {
+        bool found = false;
+        for (int i = 0; i < (int) code.size(); i++) {
+            Insn &insn = code[i];
+            if (insn.deleted || insn.op != "move" || insn.args.size() != 2) {
+                continue;
+            }
+            std::string dest = insn.args[0];
+            if (dest == insn.args[1]) {
+                insn.deleted = true;
+                hits[SELF_MOVE]++;
+                found = true;
+                continue;
+            }
+            for (int j = next(i); j < (int) code.size(); j = next(j)) {
+                Insn &later = code[j];
+                if (later.kind == LABEL_LINE || later.kind == BRANCH || reads(later, dest)) {
+                    break;
+                }
+                if (written(later) == dest) {
+                    insn.deleted = true;
+                    hits[DEAD_MOVE]++;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+
+public:
+    Peephole(const char *text, size_t n) {
+        const char *end = text + n;
+        while (text < end) {
+            const char *eol = (const char *) memchr(text, '\n', end - text);
+            if (eol == NULL) {
+                eol = end;
+            }
+            code.push_back(parse(std::string(text, eol)));
+            if (code.back().kind == LABEL_LINE) {
+                labels[code.back().label()] = code.size() - 1;
+            }
+            text = eol + 1;
+        }
+    }
+
+    void optimize() {
+        for (int round = 0; round < 4; round++) {
+            bool found = false;
+            for (int i = 0; i < (int) code.size(); i++) {
+                if (!code[i].deleted && forward_push_pop(i)) {
+                    found = true;
+                }
+            }
+            found |= eliminate_loads();
+            found |= chain_branches();
+            found |= remove_moves();
+            if (!found) {
+                break;
+            }
+        }
+    }
+
+    void write(ostream &out) {
+        for (size_t i = 0; i < code.size(); i++) {
+            const Insn &insn = code[i];
+            if (insn.deleted) {
+                continue;
+            }
+            if (!insn.changed) {
+                out << insn.line << "\n";
+                continue;
+            }
+            out << "\t" << insn.op << "\t";
+            for (size_t a = 0; a < insn.args.size(); a++) {
+                out << (a ? " " : "") << insn.args[a];
+            }
+            out << "\n";
+        }
+    }
+};
+
+}
+
+void peephole_optimize(const char *text, size_t n, ostream &out)
+{
+    Peephole p(text, n);
+    p.optimize();
+    p.write(out);
+}
+
+void print_peephole_stats(ostream &out)
+{
+    out << "peephole:";
+    for (int i = 0; i < NUM_PATTERNS; i++) {
+        out << (i ? ", " : " ") << pattern_names[i] << " " << hits[i];
+    }
+    out << endl;
+}
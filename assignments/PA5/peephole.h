@@ -0,0 +1,38 @@
+#ifndef _PEEPHOLE_H_
+#define _PEEPHOLE_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  peephole.h
+//
+//  Under -O each method and initializer is generated into a buffer of
+//  its own, and peephole_optimize() rewrites the buffered instructions
+//  before they are written out:
+//
+//    - a value pushed and popped again with nothing in between that
+//      touches $sp is moved instead, where it was pushed if its
+//      register is overwritten in between;
+//    - a load of a word just loaded or stored from a register, with the
+//      base register unchanged and no store or call in between, becomes
+//      a move, or goes if it is into the same register;
+//    - a branch to a branch goes to the second one's target, and a
+//      branch to the next instruction goes;
+//    - a move to a register that is overwritten before it is read, or
+//      to the register itself, goes.
+//
+//  It only knows the instructions cgen emits.  Anything else (calls,
+//  labels, jumps, unknown lines) ends what it knows about registers
+//  and memory.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "cool-io.h"
+
+// Rewrites the n characters of instructions at text and writes them to
+// out.
+void peephole_optimize(const char *text, size_t n, ostream &out);
+
+// Prints how often each rewrite was made.
+void print_peephole_stats(ostream &out);
+
+#endif
@@ -0,0 +1,52 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  bench.h
+//
+//  What the *_bench programs share.  Include it from the file with
+//  main() only: it defines cool_yylval, which utilities.cc prints
+//  tokens from, because a bench is linked without a lexer or parser.
+//
+//  BenchTimer times a run of steps:
+//
+//      BenchTimer timer;
+//      ... first step ...
+//      timer.report("first step", n);     // n operations since the start
+//      ... second step ...
+//      timer.report("second step", n);    // n operations since the first
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <time.h>
+#include "cool-parse.h"
+
+YYSTYPE cool_yylval;
+
+class BenchTimer {
+private:
+  clock_t start;
+public:
+  BenchTimer() : start(clock()) { }
+
+  // Prints how long the n operations since the last report took, and
+  // starts timing the next step.
+  void report(const char *what, int n)
+  {
+    double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("%-24s %9d ops %8.3f s %10.1f ns/op\n",
+	   what, n, secs, n ? secs * 1e9 / n : 0.0);
+    start = clock();
+  }
+};
+
+#endif
@@ -0,0 +1,131 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _BINARY_IO_H_
+#define _BINARY_IO_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  binary-io.h
+//
+//  A compact binary form of the token stream and of the typed AST, for
+//  the phases to hand to each other instead of the text written by
+//  dump_cool_token and dump_with_types.  The -b flag makes a phase write
+//  it; every reader recognizes it by its first byte, so the text dumps
+//  can still be fed to any phase for debugging.
+//
+//  A file consists of
+//
+//      header    the magic bytes "\177COOL", a kind byte ('T' for a token
+//                stream, 'A' for an AST) and a version byte
+//      symbols   the identifier, string and integer tables, each a count
+//                followed by that many length-prefixed, '\0'-terminated
+//                strings
+//      body      a length-prefixed payload that refers to symbols by
+//                their position in the tables above, plus one (0 is
+//                reserved for a missing symbol)
+//
+//  All numbers are unsigned LEB128: seven bits per byte, low bits first,
+//  with the top bit set on every byte but the last.  A symbol is written
+//  once however often the body uses it.
+//
+//  The reader maps a regular input file instead of reading it, and
+//  interns the strings of the symbol section directly from the mapping.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "cool-io.h"
+#include "stringtab.h"
+
+#define BINARY_TOKENS   'T'
+#define BINARY_AST      'A'
+
+class BinaryWriter {
+private:
+   std::string body;
+
+   // The symbols used so far, in the order they were first used.
+   std::map<Symbol, int> id_index, str_index, int_index;
+   std::vector<Symbol> ids, strs, ints;
+
+   void put_symbol(std::map<Symbol, int>& index,
+		   std::vector<Symbol>& order, Symbol s);
+   static void put_table(std::string& out, std::vector<Symbol>& order);
+public:
+   void put_byte(int b)       { body += (char) b; }
+   void put_int(unsigned int n);
+   void put_chars(const char *s, int len);
+
+   // Symbols from idtable, stringtable and inttable respectively.
+   void put_id(Symbol s)      { put_symbol(id_index, ids, s); }
+   void put_str(Symbol s)     { put_symbol(str_index, strs, s); }
+   void put_int_const(Symbol s) { put_symbol(int_index, ints, s); }
+
+   // Writes the header, the symbol section and the body.
+   void write(ostream& s, char kind);
+};
+
+class BinaryReader {
+private:
+   const unsigned char *data;   // the whole input
+   size_t size;
+   bool mapped;                 // data is an mmap of the input file
+   const unsigned char *cur;    // read position in the body
+   const unsigned char *end;    // end of the body
+
+   std::vector<Symbol> ids, strs, ints;
+
+   void truncated();
+   void get_table(std::vector<Symbol>& out, int kind);
+   Symbol get_symbol(std::vector<Symbol>& table);
+public:
+   // Reads the header and interns the symbol section.  The stream must
+   // be positioned at the start of the input.
+   BinaryReader(FILE *f, char kind);
+   ~BinaryReader();
+
+   bool at_end()              { return cur == end; }
+   int get_byte();
+   unsigned int get_int();
+   char *get_chars();           // a fresh '\0'-terminated copy
+
+   Symbol get_id()            { return get_symbol(ids); }
+   Symbol get_str()           { return get_symbol(strs); }
+   Symbol get_int_const()     { return get_symbol(ints); }
+};
+
+// Is the next byte of f the start of a binary file?  Nothing is consumed.
+bool is_binary_input(FILE *f);
+
+//
+// Token streams.  A stream is a sequence of tokens and file name markers
+// (the "#name" lines of the text dump), closed by a 0 token.
+//
+union YYSTYPE;
+
+void dump_binary_file_name(BinaryWriter& w, char *name);
+void dump_binary_token(BinaryWriter& w, int lineno, int token, YYSTYPE& yylval);
+void end_binary_tokens(BinaryWriter& w);
+
+// Returns the next token, or 0 at the end of the stream.  A file name
+// marker updates filename and is skipped.
+int read_binary_token(BinaryReader& r, int& lineno, char *&filename,
+		      YYSTYPE& yylval);
+
+//
+// ASTs, written by the dump_binary member of each node (ast-binary.cc).
+//
+class Program_class;
+
+void dump_binary_ast(ostream& s, Program_class *root);
+Program_class *read_binary_ast(FILE *f);
+
+#endif
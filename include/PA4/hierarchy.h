@@ -0,0 +1,167 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _HIERARCHY_H_
+#define _HIERARCHY_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  hierarchy.h
+//
+//  ClassHierarchy numbers the classes of an inheritance tree so that
+//  questions about it take no walk up the parent chain.
+//
+//  Each class gets the numbers a depth-first traversal from the root
+//  visits it at (pre) and leaves it at (post).  Class d inherits from
+//  class a exactly when a's interval [pre, post] contains d's, so a
+//  subtype test is two comparisons.
+//
+//  Each class also keeps its 2^k-th ancestor for every k, so the least
+//  upper bound of two classes is found by lifting one of them in
+//  O(log depth) subtype tests.
+//
+//  Use it as
+//
+//      ClassHierarchy h;
+//      h.add_class(name, parent);   // for every class, in any order
+//      h.build();
+//
+//  A class whose parent was never added is a root (Object, normally).
+//  The graph must be acyclic.  Symbols that are not classes are not
+//  subclasses of anything and have no least upper bound.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include "stringtab.h"
+
+class ClassHierarchy
+{
+private:
+   struct Node {
+      Symbol name;
+      Symbol parent_name;
+      int parent;        // index in nodes, or -1 for a root
+      int pre, post;     // depth-first entry and exit numbers
+      int depth;         // 0 for a root
+   };
+
+   std::vector<Node> nodes;
+   std::vector<int> node_of;           // by Symbol index; -1 if no class
+   std::vector<std::vector<int> > up;  // up[k][v]: the 2^k-th ancestor of v,
+                                       // or v's root if there are fewer
+
+   int node(Symbol s) const
+   {
+      unsigned int i = s->get_index();
+      return i < node_of.size() ? node_of[i] : -1;
+   }
+
+   bool contains(int a, int d) const
+   {
+      return nodes[a].pre <= nodes[d].pre && nodes[d].post <= nodes[a].post;
+   }
+
+public:
+   void add_class(Symbol name, Symbol parent)
+   {
+      unsigned int i = name->get_index();
+      if (i >= node_of.size())
+	 node_of.resize(i + 1, -1);
+      node_of[i] = nodes.size();
+      Node n = { name, parent, -1, 0, 0, 0 };
+      nodes.push_back(n);
+   }
+
+   // Numbers the classes added so far.
+   void build()
+   {
+      int n = nodes.size();
+
+      // Children, as consecutive runs of kids; v's are kids[first[v]] up
+      // to kids[first[v+1]].
+      std::vector<int> first(n + 1, 0), kids(n), fill;
+      for (int v = 0; v < n; v++) {
+	 nodes[v].parent = node(nodes[v].parent_name);
+	 if (nodes[v].parent >= 0)
+	    first[nodes[v].parent + 1]++;
+      }
+      for (int v = 0; v < n; v++)
+	 first[v + 1] += first[v];
+      fill.assign(first.begin(), first.end() - 1);
+      for (int v = 0; v < n; v++)
+	 if (nodes[v].parent >= 0)
+	    kids[fill[nodes[v].parent]++] = v;
+
+      // An explicit stack, since inheritance chains can be long.  Each
+      // entry is a class and the next of its children to visit.
+      int counter = 0, max_depth = 0;
+      std::vector<std::pair<int,int> > stack;
+      for (int root = 0; root < n; root++) {
+	 if (nodes[root].parent >= 0)
+	    continue;
+	 nodes[root].depth = 0;
+	 nodes[root].pre = counter++;
+	 stack.push_back(std::make_pair(root, first[root]));
+	 while (!stack.empty()) {
+	    int v = stack.back().first;
+	    int &next = stack.back().second;
+	    if (next == first[v + 1]) {
+	       nodes[v].post = counter++;
+	       stack.pop_back();
+	       continue;
+	    }
+	    int c = kids[next++];
+	    nodes[c].depth = nodes[v].depth + 1;
+	    if (nodes[c].depth > max_depth)
+	       max_depth = nodes[c].depth;
+	    nodes[c].pre = counter++;
+	    stack.push_back(std::make_pair(c, first[c]));
+	 }
+      }
+
+      up.assign(1, std::vector<int>(n));
+      for (int v = 0; v < n; v++)
+	 up[0][v] = nodes[v].parent >= 0 ? nodes[v].parent : v;
+      for (int k = 1; (1 << k) <= max_depth; k++) {
+	 up.push_back(std::vector<int>(n));
+	 for (int v = 0; v < n; v++)
+	    up[k][v] = up[k - 1][up[k - 1][v]];
+      }
+   }
+
+   bool is_class(Symbol s) const        { return node(s) >= 0; }
+
+   // Does sub inherit from super (or equal it)?
+   bool is_subclass(Symbol sub, Symbol super) const
+   {
+      int d = node(sub), a = node(super);
+      return d >= 0 && a >= 0 && contains(a, d);
+   }
+
+   // The least common ancestor of a and b, or NULL if there is none.
+   Symbol lub(Symbol a, Symbol b) const
+   {
+      int x = node(a), y = node(b);
+      if (x < 0 || y < 0)
+	 return NULL;
+      if (contains(x, y))
+	 return a;
+      for (int k = up.size() - 1; k >= 0; k--)
+	 if (!contains(up[k][x], y))
+	    x = up[k][x];
+      x = up[0][x];
+      return contains(x, y) ? nodes[x].name : NULL;
+   }
+
+   // The depth-first numbers and the depth of a class; s must be one.
+   int pre(Symbol s) const              { return nodes[node(s)].pre; }
+   int post(Symbol s) const             { return nodes[node(s)].post; }
+   int depth(Symbol s) const            { return nodes[node(s)].depth; }
+};
+
+#endif
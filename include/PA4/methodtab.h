@@ -0,0 +1,74 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _METHODTAB_H_
+#define _METHODTAB_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  methodtab.h
+//
+//  A MethodTable holds every method a class has, inherited or its own,
+//  resolved to the definition that applies to the class.  A class's
+//  table starts as a copy of its parent's; add() then overrides the
+//  entry of an inherited method in place or appends a new one.  The
+//  entries are therefore in dispatch table order: the parent's methods
+//  first, in the parent's order, followed by the methods the class
+//  introduces.
+//
+//  Each entry is the class that defines the method and the method.  A
+//  lookup by name is one hash probe.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "cool-tree.h"
+
+class MethodTable
+{
+public:
+   typedef std::pair<Class_, method_class *> Slot;
+
+private:
+   std::vector<Slot> slots;
+   std::unordered_map<Symbol, int> index;   // method name to slot
+
+public:
+   // Define m, a method of cls, overriding any method of the same name.
+   void add(Class_ cls, method_class *m)
+   {
+      Symbol name = m->get_name();
+      std::unordered_map<Symbol, int>::iterator it = index.find(name);
+      if (it == index.end()) {
+	 index[name] = slots.size();
+	 slots.push_back(Slot(cls, m));
+      } else {
+	 slots[it->second] = Slot(cls, m);
+      }
+   }
+
+   // The slot of the method called name, or -1 if there is none.
+   int slot(Symbol name) const
+   {
+      std::unordered_map<Symbol, int>::const_iterator it = index.find(name);
+      return it == index.end() ? -1 : it->second;
+   }
+
+   // The method called name, or NULL if there is none.
+   method_class *lookup(Symbol name) const
+   {
+      int i = slot(name);
+      return i < 0 ? NULL : slots[i].second;
+   }
+
+   int size() const                     { return slots.size(); }
+   const Slot &nth(int i) const         { return slots[i]; }
+};
+
+#endif
@@ -14,6 +14,9 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
+#include <functional>
+#include <stdint.h>
+#include <vector>
 #include "list.h"
 
 //
@@ -35,37 +38,33 @@ public:
 //
 // SymbolTable<SYM,DAT> describes a symbol table mapping symbols of
 //    type `SYM' to data of type `DAT *'.  It is implemented as a
-//    list of lists of `SymtabEntry<SYM,DAT> *'.  The inner list is
-//    a scope, a mapping from symbols to data, and the outer list is
-//    a list of scopes. 
+//    stack of `SymtabEntry<SYM,DAT>' bindings, with the innermost
+//    binding on top.  A scope is the run of bindings above the height
+//    the stack had when the scope was entered.
 //
-//    `tbl' points to the current top scope.
+//    Each binding also records the binding of the same symbol that it
+//    shadows, and a hash table maps every symbol to its innermost
+//    binding.  Lookups therefore never search the stack, and entering
+//    or leaving a scope only moves the top of it.
 //
-//    `enterscope' makes the table point to a new scope whose parent
-//       is the scope it pointed to previously.
+//    `enterscope' records the height of the binding stack as the start
+//       of a new scope.
 //
-//    `exitscope' makes the table point to the parent scope of the
-//        current scope.  Note that the old child scope is not
-//        deallocated.  One may save the state of a symbol table
-//        at a given point by copying it with `operator ='
+//    `exitscope' pops the bindings of the current scope, pointing each
+//        symbol back at the binding it shadowed, and forgets the scope.
+//        One may save the state of a symbol table at a given point by
+//        copying it with `operator ='.
 //
-//    `addid(s,i)' adds a symbol table entry to the current scope of
-//        the symbol table mapping symbol `s' to data `d'.  The old
-//        top scope isn't modified; a new scope is created whose
-//        entry list is the new entry followed by the old entry list,
-//        and whose tail is the old top scope's parent.  The table
-//        is made to point to this new scope.
+//    `addid(s,i)' pushes a binding of symbol `s' to data `d' on top of
+//        the stack and makes it the innermost binding of `s'.  The
+//        returned entry stays valid until the next `addid' or
+//        `exitscope'.
 //
-//    `lookup(s)' looks for the symbol `s', starting at the top scope
-//        and proceeding down the list of scopes until either an
-//        entry is found whose `get_id()' equals `s', or the end of
-//        the root scope is reached.  It returns the data item
-//        associated with the entry, or NULL if no such entry exists.
+//    `lookup(s)' returns the data item of the innermost binding of
+//        `s', or NULL if there is no such binding.
 //
-//    
-//    `probe(s)' checks the top scope for an entry whose `get_id()'
-//        equals `s', and returns the entry's `get_info()' if
-//        found, and NULL otherwise.
+//    `probe(s)' returns the data item of the innermost binding of `s'
+//        if that binding is in the top scope, and NULL otherwise.
 //
 //    `dump()' prints the symbols in the symbol table.
 //
@@ -74,15 +73,86 @@ template <class SYM, class DAT>
 class SymbolTable
 {
    typedef SymtabEntry<SYM,DAT> ScopeEntry;
-   typedef List<ScopeEntry> Scope;
-   typedef List<Scope> ScopeList;
+
+   struct Binding {
+      ScopeEntry entry;
+      int shadowed;        // the previous binding of the symbol, or -1
+      Binding(SYM s, DAT *i, int sh) : entry(s,i), shadowed(sh) { }
+   };
+
+   // A slot of the hash table, which uses open addressing and linear
+   // probing.  A symbol keeps its slot once it has one, with an
+   // innermost binding of -1 while it is not bound.
+   struct Slot {
+      SYM id;
+      int innermost;       // index in bindings, or -1
+      bool used;
+      Slot() : id(), innermost(-1), used(false) { }
+   };
+
 private:
-   ScopeList  *tbl;
+   std::vector<Binding> bindings;   // the binding stack
+   std::vector<int> scopes;         // where each scope starts in bindings
+   std::vector<Slot> slots;         // a power of two in size
+   int slot_bits;                   // log2 of that
+   int num_slots_used;
+
+   // The slot s is looked for from.  std::hash of a pointer is the
+   // pointer itself, whose low bits are always clear, so it is spread
+   // over the table by Fibonacci hashing: multiplied by 2^64 / phi,
+   // keeping the top slot_bits bits of the product.
+   size_t home_slot(SYM s) const
+   {
+       uint64_t h = (uint64_t) std::hash<SYM>()(s);
+       return (size_t) ((h * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - slot_bits));
+   }
+
+   // The slot for s: the one holding it, or the empty one it belongs in.
+   Slot *find_slot(SYM s)
+   {
+       size_t mask = slots.size() - 1;
+       size_t i = home_slot(s);
+       while (slots[i].used && !(slots[i].id == s))
+	   i = (i + 1) & mask;
+       return &slots[i];
+   }
+
+   // Doubles the hash table, keeping it at most half full.
+   void grow()
+   {
+       std::vector<Slot> old;
+       old.swap(slots);
+       slots.resize(old.empty() ? 64 : 2 * old.size());
+       slot_bits = old.empty() ? 6 : slot_bits + 1;
+       for (size_t i = 0; i < old.size(); i++)
+	   if (old[i].used)
+	       *find_slot(old[i].id) = old[i];
+   }
+
+   // The innermost binding of s, or NULL.
+   Binding *innermost(SYM s)
+   {
+       if (slots.empty())
+	   return NULL;
+       Slot *slot = find_slot(s);
+       if (!slot->used || slot->innermost < 0)
+	   return NULL;
+       return &bindings[slot->innermost];
+   }
+
 public:
-   SymbolTable(): tbl(NULL) { }     // create a new symbol table
+   SymbolTable(): slot_bits(0), num_slots_used(0) { }     // create a new symbol table
 
-   // Create pointer to current symbol table.
-   SymbolTable &operator =(const SymbolTable &s) { tbl = s.tbl; return *this; }
+   // Copy the current symbol table.
+   SymbolTable &operator =(const SymbolTable &s)
+   {
+       bindings = s.bindings;
+       scopes = s.scopes;
+       slots = s.slots;
+       slot_bits = s.slot_bits;
+       num_slots_used = s.num_slots_used;
+       return *this;
+   }
 
    void fatal_error(char * msg)
    {
@@ -90,36 +160,45 @@ public:
      exit(1);
    } 
 
-   // Enter a new scope.  A symbol table is organized as a list of
-   // lists.  The head of the list is the innermost scope, the tail
-   // holds the outer scopes.  A scope must be entered before anything
-   // can be added to the table.
-
+   // Enter a new scope.  A scope must be entered before anything can
+   // be added to the table.
    void enterscope()
    {
-       // The cast of NULL is required for template instantiation to work
-       // correctly.
-       tbl = new ScopeList((Scope *) NULL, tbl);
+       scopes.push_back(bindings.size());
    }
 
    // Pop the first scope off of the symbol table.
    void exitscope()
    {
        // It is an error to exit a scope that doesn't exist.
-       if (tbl == NULL) {
+       if (scopes.empty()) {
 	   fatal_error("exitscope: Can't remove scope from an empty symbol table.");
        }
-       tbl = tbl->tl();
+       int start = scopes.back();
+       scopes.pop_back();
+       while ((int) bindings.size() > start) {
+	   Binding &b = bindings.back();
+	   find_slot(b.entry.get_id())->innermost = b.shadowed;
+	   bindings.pop_back();
+       }
    }
 
    // Add an item to the symbol table.
    ScopeEntry *addid(SYM s, DAT *i)
    {
        // There must be at least one scope to add a symbol.
-       if (tbl == NULL) fatal_error("addid: Can't add a symbol without a scope.");
-       ScopeEntry * se = new ScopeEntry(s,i);
-       tbl = new ScopeList(new Scope(se, tbl->hd()), tbl->tl());
-       return(se);
+       if (scopes.empty()) fatal_error("addid: Can't add a symbol without a scope.");
+       if (2 * (num_slots_used + 1) > (int) slots.size())
+	   grow();
+       Slot *slot = find_slot(s);
+       if (!slot->used) {
+	   slot->used = true;
+	   slot->id = s;
+	   num_slots_used++;
+       }
+       bindings.push_back(Binding(s, i, slot->innermost));
+       slot->innermost = bindings.size() - 1;
+       return &bindings.back().entry;
    }
    
    // Lookup an item through all scopes of the symbol table.  If found
@@ -128,43 +207,37 @@ public:
 
    DAT * lookup(SYM s)
    {
-       for(ScopeList *i = tbl; i != NULL; i=i->tl()) {
-	   for( Scope *j = i->hd(); j != NULL; j = j->tl()) {
-	       if (s == j->hd()->get_id()) {
-		   return (j->hd()->get_info());
-	       }
-	   }
-       }
-       return NULL;
+       Binding *b = innermost(s);
+       return b ? b->entry.get_info() : NULL;
    }
 
    // probe the symbol table.  Check the top scope (only) for the item
    // 's'.  If found, return the information field.  If not return NULL.
    DAT *probe(SYM s)
    {
-       if (tbl == NULL) {
+       if (scopes.empty()) {
 	   fatal_error("probe: No scope in symbol table.");
        }
-       for(Scope *i = tbl->hd(); i != NULL; i = i->tl()) {
-	   if (s == i->hd()->get_id()) {
-	       return(i->hd()->get_info());
-	   }
-       }
-       return(NULL);
+       Binding *b = innermost(s);
+       if (b == NULL || b - &bindings[0] < scopes.back())
+	   return NULL;
+       return b->entry.get_info();
    }
 
-   // Prints out the contents of the symbol table  
+   // Prints out the contents of the symbol table, innermost scope and
+   // latest binding first.
    void dump()
    {
-      for(ScopeList *i = tbl; i != NULL; i = i->tl()) {
+      int end = bindings.size();
+      for (int i = scopes.size() - 1; i >= 0; i--) {
          cerr << "\nScope: \n";
-         for(Scope *j = i->hd(); j != NULL; j = j->tl()) {
-            cerr << "  " << j->hd()->get_id() << endl;
+         for (int j = end - 1; j >= scopes[i]; j--) {
+            cerr << "  " << bindings[j].entry.get_id() << endl;
          }
+         end = scopes[i];
       }
    }
  
 };
 
 #endif
-
@@ -0,0 +1,105 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _ASMBUF_H_
+#define _ASMBUF_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  asmbuf.h
+//
+//  The code generator writes the whole program into an AsmStream and
+//  copies it to the output file in one write at the end.
+//
+//  An AsmStream is an ostream, so everything that emits code through an
+//  ostream& works on it unchanged.  Its buffer only grows: nothing is
+//  written until write_to(), and endl, which on a file stream makes a
+//  write system call per line, costs nothing.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <streambuf>
+#include "cool-io.h"
+
+class AsmBuffer : public std::streambuf
+{
+private:
+   char *base;
+   size_t capacity;
+
+   // Makes room for at least need more characters.
+   void grow(size_t need)
+   {
+      size_t used = pptr() - base;
+      while (capacity - used < need)
+	 capacity *= 2;
+      base = (char *) realloc(base, capacity);
+      if (base == NULL) {
+	 cerr << "Out of memory for the assembly buffer" << endl;
+	 exit(1);
+      }
+      setp(base, base + capacity);
+      pbump(used);
+   }
+
+protected:
+   int_type overflow(int_type c)
+   {
+      if (c != traits_type::eof()) {
+	 grow(1);
+	 *pptr() = c;
+	 pbump(1);
+      }
+      return traits_type::not_eof(c);
+   }
+
+   std::streamsize xsputn(const char *s, std::streamsize n)
+   {
+      if (epptr() - pptr() < n)
+	 grow(n);
+      memcpy(pptr(), s, n);
+      pbump(n);
+      return n;
+   }
+
+   int sync()                           { return 0; }
+
+public:
+   AsmBuffer(size_t initial = 1 << 20) : capacity(initial)
+   {
+      base = (char *) malloc(capacity);
+      setp(base, base + capacity);
+   }
+
+   ~AsmBuffer()                         { free(base); }
+
+   const char *data() const             { return base; }
+   size_t size() const                  { return pptr() - base; }
+};
+
+class AsmStream : public ostream
+{
+private:
+   AsmBuffer buf;
+
+public:
+   AsmStream(size_t initial = 1 << 20) : ostream(NULL), buf(initial) { rdbuf(&buf); }
+
+   const char *data() const             { return buf.data(); }
+   size_t size() const                  { return buf.size(); }
+
+   // Copies everything written so far to os.
+   void write_to(ostream &os)
+   {
+      os.write(buf.data(), buf.size());
+      os.flush();
+   }
+};
+
+#endif
@@ -11,6 +11,8 @@
 
 #include <assert.h>
 #include <string.h>
+#include <new>
+#include <vector>
 #include "list.h"    // list template
 #include "cool-io.h"
 
@@ -28,12 +30,16 @@ extern ostream& operator<<(ostream& s, Symbol sym);
 
 class Entry {
 protected:
-  char *str;     // the string
+  char *str;     // the string; not copied, so it must outlive the Entry
   int  len;      // the length of the string (without trailing \0)
   int index;     // a unique index for each string
+  unsigned int hash;  // hash_string(str, len), kept for the table's index
 public:
   Entry(char *s, int l, int i);
 
+  // the hash of the first len characters of s
+  static unsigned int hash_string(const char *s, int len);
+
   // is string argument equal to the str of this Entry?
   int equal_string(char *s, int len) const;  
                          
@@ -45,6 +51,8 @@ public:
   // Return the str and len components of the Entry.
   char *get_string() const;
   int get_len() const;
+  int get_index() const                     { return index; }
+  unsigned int get_hash() const             { return hash; }
 };
 
 //
@@ -83,6 +91,47 @@ typedef StringEntry *StringEntryP;
 typedef IdEntry *IdEntryP;
 typedef IntEntry *IntEntryP;
 
+//////////////////////////////////////////////////////////////////////////
+//
+//  Arenas
+//
+//  An arena hands out memory from large chunks by bumping a pointer.
+//  Nothing is freed until the arena itself goes away, which suits the
+//  string tables: entries live as long as the compiler runs.
+//
+//////////////////////////////////////////////////////////////////////////
+
+class Arena
+{
+private:
+   char *chunk;       // the chunk being carved up
+   size_t used;       // bytes of it handed out so far
+   size_t size;       // its size
+   std::vector<char *> chunks;   // every chunk, to free them
+
+   // statistics
+   int allocs;        // calls to alloc
+   size_t bytes;      // bytes requested from alloc
+   size_t reserved;   // bytes in all chunks
+
+   Arena(const Arena&);
+   Arena& operator=(const Arena&);
+public:
+   Arena(): chunk(NULL), used(0), size(0), allocs(0), bytes(0), reserved(0) { }
+   ~Arena();
+
+   // n bytes aligned to align, which must be a power of two
+   void *alloc(size_t n, size_t align = sizeof(void *));
+
+   // free everything allocated so far, all at once
+   void release();
+
+   int num_allocs() const       { return allocs; }
+   size_t num_bytes() const     { return bytes; }
+   int num_chunks() const       { return chunks.size(); }
+   size_t num_reserved() const  { return reserved; }
+};
+
 //////////////////////////////////////////////////////////////////////////
 //
 //  String Tables
@@ -95,8 +144,22 @@ class StringTable
 protected:
    List<Elem> *tbl;   // a string table is a list
    int index;         // the current index
+
+   // The same entries, indexed two ways: entries[i] is the entry with
+   // index i, and buckets is an open-addressed hash table over the
+   // strings whose slots hold an entry's index plus one (0 is empty).
+   std::vector<Elem *> entries;
+   std::vector<int> buckets;
+
+   // The entries, their strings and the list cells are all allocated
+   // here, rather than each with its own new.
+   Arena arena;
+   int vector_allocs;   // times entries or buckets took new storage
+
+   int find_bucket(char *s, int len, unsigned int h);
+   void grow();
 public:
-   StringTable(): tbl((List<Elem> *) NULL), index(0) { }   // an empty table
+   StringTable(): tbl((List<Elem> *) NULL), index(0), vector_allocs(0) { }   // an empty table
    // The following methods each add a string to the string table.  
    // Only one copy of each string is maintained.  
    // Returns a pointer to the string table entry with the string.
@@ -121,6 +184,9 @@ public:
 
    void print();  // print the entire table; for debugging
 
+   // print the number of entries, the memory they take up and the
+   // allocations the table made
+   void print_stats(ostream& s, const char *name);
 };
 
 class IdTable : public StringTable<IdEntry> { };
@@ -140,4 +206,7 @@ public:
 extern IdTable idtable;
 extern IntTable inttable;
 extern StrTable stringtable;
+
+// print_stats for all three tables
+void print_string_table_stats(ostream& s);
 #endif
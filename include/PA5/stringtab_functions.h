@@ -6,16 +6,19 @@
 
 #include "cool-io.h"
 #define MAXSIZE 1000000
-#define min(a,b) (a > b ? b : a)
 
 #include "stringtab.h"
 #include <stdio.h>
 
 //
 // A string table is implemented a linked list of Entrys.  Each Entry
-// in the list has a unique string.
+// in the list has a unique string.  The list is kept for code that walks
+// the whole table; searches go through the hash index instead, and
+// lookups by index through the entries vector.
 //
 
+#define INITIAL_BUCKETS 256
+
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s)
 {
@@ -23,26 +26,76 @@ Elem *StringTable<Elem>::add_string(char *s)
 }
 
 //
-// Add a string requires two steps.  First, the list is searched; if the
-// string is found, a pointer to the existing Entry for that string is 
-// returned.  If the string is not found, a new Entry is created and added
-// to the list.
+// Returns the bucket that holds the entry for the first len characters
+// of s, or the empty bucket where that entry belongs.  Collisions are
+// resolved by linear probing; the table is never more than half full,
+// so probe sequences stay short.
+//
+template <class Elem>
+int StringTable<Elem>::find_bucket(char *s, int len, unsigned int h)
+{
+  unsigned int mask = buckets.size() - 1;
+  for (unsigned int b = h & mask; ; b = (b + 1) & mask) {
+    int i = buckets[b];
+    if (i == 0)
+      return b;
+    Elem *e = entries[i - 1];
+    if (e->get_hash() == h && e->equal_string(s,len))
+      return b;
+  }
+}
+
+//
+// Doubles the hash index and reinserts every entry, using the hash saved
+// in each Entry rather than rehashing the strings.
+//
+template <class Elem>
+void StringTable<Elem>::grow()
+{
+  unsigned int size = buckets.empty() ? INITIAL_BUCKETS : 2 * buckets.size();
+  buckets.assign(size, 0);
+  vector_allocs++;
+  unsigned int mask = size - 1;
+  for (int i = 0; i < index; i++) {
+    unsigned int b = entries[i]->get_hash() & mask;
+    while (buckets[b] != 0)
+      b = (b + 1) & mask;
+    buckets[b] = i + 1;
+  }
+}
+
+//
+// Add a string requires two steps.  First, the hash index is searched; if
+// the string is found, a pointer to the existing Entry for that string is
+// returned.  If the string is not found, a new Entry and a copy of the
+// string are allocated in the arena and added to the list and the index.
 //
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s, int maxchars)
 {
-  int len = min((int) strlen(s),maxchars);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
+  int len = strnlen(s,maxchars);
+  unsigned int h = Entry::hash_string(s,len);
 
-  Elem *e = new Elem(s,len,index++);
-  tbl = new List<Elem>(e, tbl);
+  if (2 * (index + 1) > (int) buckets.size())
+    grow();
+  int b = find_bucket(s,len,h);
+  if (buckets[b] != 0)
+    return entries[buckets[b] - 1];
+
+  char *str = (char *) arena.alloc(len + 1, 1);
+  memcpy(str, s, len);
+  str[len] = '\0';
+  Elem *e = new (arena.alloc(sizeof(Elem))) Elem(str,len,index++);
+  tbl = new (arena.alloc(sizeof(List<Elem>))) List<Elem>(e, tbl);
+  if (entries.size() == entries.capacity())
+    vector_allocs++;
+  entries.push_back(e);
+  buckets[b] = index;
   return e;
 }
 
 //
-// To look up a string, the list is scanned until a matching Entry is located.
+// To look up a string, the hash index is probed for a matching Entry.
 // If no such entry is found, an assertion failure occurs.  Thus, this function
 // is used only for strings that one expects to find in the table.
 //
@@ -50,11 +103,10 @@ template <class Elem>
 Elem *StringTable<Elem>::lookup_string(char *s)
 {
   int len = strlen(s);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  assert(!buckets.empty());   // fail if the table is empty
+  int b = find_bucket(s,len,Entry::hash_string(s,len));
+  assert(buckets[b] != 0);    // fail if string is not found
+  return entries[buckets[b] - 1];
 }
 
 //
@@ -64,11 +116,8 @@ Elem *StringTable<Elem>::lookup_string(char *s)
 template <class Elem>
 Elem *StringTable<Elem>::lookup(int ind)
 {
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_index(ind))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  assert(0 <= ind && ind < index);   // fail if string is not found
+  return entries[ind];
 }
 
 //
@@ -105,3 +154,23 @@ void StringTable<Elem>::print()
 {
   list_print(cerr,tbl);
 }
+
+//
+// Everything but the entries and buckets vectors comes from the arena, so
+// the table only goes to the heap for a new chunk or when a vector grows.
+// Without the arena each entry would cost three allocations of its own
+// (the Entry, its string and its list cell).
+//
+template <class Elem>
+void StringTable<Elem>::print_stats(ostream& s, const char *name)
+{
+  size_t vector_bytes = entries.capacity() * sizeof(Elem *) +
+                        buckets.capacity() * sizeof(int);
+  s << name << ": " << index << " entries, "
+    << arena.num_allocs() << " arena allocations, "
+    << arena.num_bytes() << " bytes; heap: "
+    << arena.num_chunks() + vector_allocs << " allocations, "
+    << arena.num_reserved() + vector_bytes << " bytes ("
+    << arena.num_chunks() << " arena chunks, "
+    << vector_allocs << " for the vectors)" << endl;
+}
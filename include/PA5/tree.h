@@ -15,6 +15,7 @@
 ///////////////////////////////////////////////////////////////////////////
  
 
+#include <vector>
 #include "stringtab.h"
 #include "cool-io.h"
 
@@ -48,6 +49,10 @@
 //           the argument tree_node.  Returns "this".
 //
 //
+//   Tree nodes are allocated from tree_arena by tree_node's operator
+//   new, and deleting one does nothing.  They are all freed at once by
+//   free_tree_nodes when the compilation is over.
+//
 ////////////////////////////////////////////////////////////////////////////
 class tree_node {
 protected:
@@ -59,8 +64,38 @@ public:
     virtual void dump(ostream& stream, int n) = 0;
     int get_line_number();
     tree_node *set(tree_node *);
+
+    static void *operator new(size_t size);
+    static void operator delete(void *) { }
 };
 
+extern Arena tree_arena;
+
+// Frees every tree node.
+void free_tree_nodes();
+
+// Prints the number of nodes and arena bytes allocated since the last
+// call, which is taken to be the start of phase, and the totals so far.
+void print_tree_stats(ostream& s, const char *phase);
+
+//
+// An allocator for the containers inside tree nodes, so that they are
+// in tree_arena as well.  Memory a container gives back is not reused.
+//
+template <class T> class tree_allocator {
+public:
+    typedef T value_type;
+    tree_allocator() { }
+    template <class U> tree_allocator(const tree_allocator<U>&) { }
+    T *allocate(size_t n)      { return (T *) tree_arena.alloc(n * sizeof(T)); }
+    void deallocate(T *, size_t) { }
+};
+
+template <class T, class U>
+bool operator==(const tree_allocator<T>&, const tree_allocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const tree_allocator<T>&, const tree_allocator<U>&) { return false; }
+
 ///////////////////////////////////////////////////////////////////
 //
 //  Lists of APS objects are implemented by the "list_node"
@@ -95,8 +130,15 @@ public:
 //
 //     nth_length(int n, int &len);
 //     Returns the nth element of the list or NULL if there are not n elements.
-//     "len" is set to the length of the list.  This method is used internally
-//     by the APS package to efficiently traverse the list representation.  
+//     "len" is set to the length of the list.
+//
+//     nth, len and more take constant time.  The elements of a list are
+//     kept in an array, and a list made by appending to another shares
+//     that list's array whenever it can: if nothing has been appended
+//     to l1 yet, append(l1,l2) adds the elements of l2 to the end of
+//     l1's array instead of copying it.  l1 itself still ends where it
+//     did, so lists behave as if they were never modified, and building
+//     a list one element at a time takes linear time in all.
 //
 //     static list_node<Elem> *nil();
 //     static list_node<Elem> *single(Elem);
@@ -113,6 +155,19 @@ public:
 //////////////////////////////////////////////////////////////////////////////
 
 template <class Elem> class list_node : public tree_node {
+protected:
+    typedef std::vector<Elem, tree_allocator<Elem> > Elems;
+
+    // The list is elements [0, length) of *elems, or the single element
+    // only if elems is NULL and length is 1.
+    Elems *elems;
+    int length;
+    Elem only;
+
+    list_node() : elems(NULL), length(0), only(NULL) { }
+    Elem item(int n)   { return elems ? (*elems)[n] : only; }
+    void append_items(list_node<Elem> *l);
+    void concat(list_node<Elem> *l1, list_node<Elem> *l2);
 public:
     tree_node *copy()            { return copy_list(); }
     Elem nth(int n);
@@ -121,12 +176,12 @@ public:
     //
     int first()      { return 0; }
     int next(int n)  { return n + 1; }
-    int more(int n)  { return (n < len()); }
+    int more(int n)  { return (n < length); }
 
     virtual list_node<Elem> *copy_list() = 0;
     virtual ~list_node() { }
-    virtual int len() = 0;
-    virtual Elem nth_length(int n, int &len) = 0;
+    int len()        { return length; }
+    Elem nth_length(int n, int &len);
 
     static list_node<Elem> *nil();
     static list_node<Elem> *single(Elem);
@@ -140,36 +195,31 @@ extern int info_size;
 template <class Elem> class nil_node : public list_node<Elem> {
 public:
     list_node<Elem> *copy_list();
-    int len();
-    Elem nth_length(int n, int &len);
     void dump(ostream& stream, int n);
 };
 
 template <class Elem> class single_list_node : public list_node<Elem> {
-    Elem elem;
 public:
     single_list_node(Elem t) {
-	elem = t;
+	this->only = t;
+	this->length = 1;
     }
     list_node<Elem> *copy_list();
-    int len();
-    Elem nth_length(int n, int &len);
     void dump(ostream& stream, int n);
 };
 
 
 template <class Elem> class append_node : public list_node<Elem> {
 private:
-    list_node<Elem> *some, *rest;
+    append_node(typename list_node<Elem>::Elems *v) {
+	this->elems = v;
+	this->length = v->size();
+    }
 public:
     append_node(list_node<Elem> *l1, list_node<Elem> *l2) {
-	some = l1;
-	rest = l2;
+	this->concat(l1, l2);
     }
     list_node<Elem> *copy_list();
-    int len();
-    Elem nth(int n);
-    Elem nth_length(int n, int &len);
     void dump(ostream& stream, int n);
 };
 
@@ -196,125 +246,108 @@ template <class Elem> list_node<Elem> *list_node<Elem>::append(list_node<Elem> *
 
 template <class Elem> Elem list_node<Elem>::nth(int n)
 {
-    int len;
-    Elem tmp = nth_length(n ,len);
-
-    if (tmp)
-	return tmp;
-    else {
-	cerr << "error: outside the range of the list\n";
-	exit(1);
-    }
-}
-
-// added 10/30/06 cgs
-template <class Elem> Elem append_node<Elem>::nth(int n)
-{
-    int len;
-    Elem tmp = nth_length(n ,len);
-
-    if (tmp)
-	return tmp;
+    if (0 <= n && n < length)
+	return item(n);
     else {
 	cerr << "error: outside the range of the list\n";
 	exit(1);
     }
 }
 
-///////////////////////////////////////////////////////////////////////////
-//
-// nil_node::copy_list
-//
-// return the deep copy of the nil_node
-//
-///////////////////////////////////////////////////////////////////////////
-template <class Elem> list_node<Elem> *nil_node<Elem>::copy_list()
-{
-    return new nil_node<Elem>();
-}
-
 
 ///////////////////////////////////////////////////////////////////////////
 //
-// nil_node::len
+// list_node::nth_length
 //
-// return the length of the nil_node
+// return the nth element on the list
 //
 ///////////////////////////////////////////////////////////////////////////
-template <class Elem> int nil_node<Elem>::len()
+template <class Elem> Elem list_node<Elem>::nth_length(int n, int &len)
 {
-    return 0;
+    len = length;
+    if (0 <= n && n < length)
+	return item(n);
+    else
+	return NULL;
 }
 
 
-
 ///////////////////////////////////////////////////////////////////////////
 //
-// nil_node::nth_length
+// list_node::append_items
 //
-// return the nth element on the list
+// add the elements of l to the end of this list's array
 //
 ///////////////////////////////////////////////////////////////////////////
-template <class Elem> Elem nil_node<Elem>::nth_length(int, int &len)
+template <class Elem> void list_node<Elem>::append_items(list_node<Elem> *l)
 {
-    len = 0;
-    return NULL;
+    // Index l afresh each time; l may share (and so move) our array.
+    int n = l->length;
+    for (int i = 0; i < n; i++)
+	elems->push_back(l->item(i));
+    length = elems->size();
 }
 
 
 ///////////////////////////////////////////////////////////////////////////
 //
-// nil_node::dump
+// list_node::concat
 //
-// dump for list node
+// make this list the elements of l1 followed by those of l2; l1's array
+// is extended in place when l1 is the longest list using it
 //
 ///////////////////////////////////////////////////////////////////////////
-template <class Elem> void nil_node<Elem>::dump(ostream& stream, int n)
+template <class Elem> void list_node<Elem>::concat(list_node<Elem> *l1,
+						   list_node<Elem> *l2)
 {
-    stream << pad(n) << "(nil)\n";
+    if (l1->elems && (int) l1->elems->size() == l1->length) {
+	elems = l1->elems;
+	length = l1->length;
+    } else {
+	elems = new (tree_arena.alloc(sizeof(Elems))) Elems();
+	elems->reserve(l1->length + l2->length);
+	append_items(l1);
+    }
+    append_items(l2);
 }
 
 
 ///////////////////////////////////////////////////////////////////////////
 //
-// single_list_node::copy_list
+// nil_node::copy_list
 //
-// return the deep copy of the single_list_node
+// return the deep copy of the nil_node
 //
 ///////////////////////////////////////////////////////////////////////////
-template <class Elem> list_node<Elem> *single_list_node<Elem>::copy_list()
+template <class Elem> list_node<Elem> *nil_node<Elem>::copy_list()
 {
-    return new single_list_node<Elem>((Elem) elem->copy());
+    return new nil_node<Elem>();
 }
 
 
 ///////////////////////////////////////////////////////////////////////////
 //
-// single_list_node::len
+// nil_node::dump
 //
-// return the length of the single_list_node
+// dump for list node
 //
 ///////////////////////////////////////////////////////////////////////////
-template <class Elem> int single_list_node<Elem>::len()
+template <class Elem> void nil_node<Elem>::dump(ostream& stream, int n)
 {
-    return 1;
+    stream << pad(n) << "(nil)\n";
 }
 
 
 ///////////////////////////////////////////////////////////////////////////
 //
-// single_list_node::nth_length
+// single_list_node::copy_list
 //
-// return the nth element on the list
+// return the deep copy of the single_list_node
 //
 ///////////////////////////////////////////////////////////////////////////
-template <class Elem> Elem single_list_node<Elem>::nth_length(int n, int &len)
+template <class Elem> list_node<Elem> *single_list_node<Elem>::copy_list()
 {
-    len = 1;
-    if (n)
-	return NULL;
-    else
-	return elem;
+    return new single_list_node<Elem>((Elem) this->only->copy());
 }
 
 
@@ -327,7 +360,7 @@ template <class Elem> Elem single_list_node<Elem>::nth_length(int n, int &len)
 ///////////////////////////////////////////////////////////////////////////
 template <class Elem> void single_list_node<Elem>::dump(ostream& stream, int n)
 {
-    elem->dump(stream, n);
+    this->only->dump(stream, n);
 }
 
 
@@ -340,40 +373,12 @@ template <class Elem> void single_list_node<Elem>::dump(ostream& stream, int n)
 ///////////////////////////////////////////////////////////////////////////
 template <class Elem> list_node<Elem> *append_node<Elem>::copy_list()
 {
-    return new append_node<Elem>(some->copy_list(), rest->copy_list());
-}
-
-
-///////////////////////////////////////////////////////////////////////////
-//
-// append_node::len
-//
-// return the length of the append_node
-//
-///////////////////////////////////////////////////////////////////////////
-template <class Elem> int append_node<Elem>::len()
-{
-    return some->len() + rest->len();
-}
-
-
-///////////////////////////////////////////////////////////////////////////
-//
-// append_node::nth_length
-//
-// return the nth element on the list
-//
-///////////////////////////////////////////////////////////////////////////
-template <class Elem> Elem append_node<Elem>::nth_length(int n, int &len)
-{
-    int rlen;
-    Elem tmp = some->nth_length(n, len);
-
-    if (!tmp) {
-	tmp = rest->nth_length(n-len, rlen);
-	len += rlen;
-    }
-    return tmp;
+    typename list_node<Elem>::Elems *copy =
+	new (tree_arena.alloc(sizeof(*copy))) typename list_node<Elem>::Elems();
+    copy->reserve(this->length);
+    for (int i = 0; i < this->length; i++)
+	copy->push_back((Elem) this->item(i)->copy());
+    return new append_node<Elem>(copy);
 }
 
 
@@ -388,10 +393,10 @@ template <class Elem> void append_node<Elem>::dump(ostream& stream, int n)
 {
     int i, size;
 
-    size = len();
+    size = this->len();
     stream << pad(n) << "list\n";
     for (i = 0; i < size; i++)
-      nth(i)->dump(stream, n+2);
+      this->nth(i)->dump(stream, n+2);
     stream << pad(n) << "(end_of_list)\n";
 }
 
@@ -18,6 +18,7 @@
 #include <unistd.h>     // for getopt
 #include "cool-parse.h" // bison-generated file; defines tokens
 #include "utilities.h"
+#include "binary-io.h"
 
 //
 //  The lexer keeps this global variable up to date with the line number
@@ -42,6 +43,7 @@ extern int optind;  // used for option processing (man 3 getopt for more info)
 //
 extern int yy_flex_debug;      // Flex debugging; see flex documentation.
 extern int lex_verbose;        // Controls printing of tokens.
+extern int binary_format;      // Option -b: write the tokens in binary.
 void handle_flags(int argc, char *argv[]);
 
 //
@@ -59,6 +61,7 @@ extern void dump_cool_token(ostream& out, int lineno,
 
 int main(int argc, char** argv) {
 	int token;
+	BinaryWriter tokens;
 	
 	handle_flags(argc,argv);
 
@@ -77,13 +80,23 @@ int main(int argc, char** argv) {
 	    //
 	    // Scan and print all tokens.
 	    //
-	    cout << "#name \"" << argv[optind] << "\"" << endl;
+	    if (binary_format)
+		dump_binary_file_name(tokens, argv[optind]);
+	    else
+		cout << "#name \"" << argv[optind] << "\"" << endl;
 	    while ((token = cool_yylex()) != 0) {
-		dump_cool_token(cout, curr_lineno, token, cool_yylval);
+		if (binary_format)
+		    dump_binary_token(tokens, curr_lineno, token, cool_yylval);
+		else
+		    dump_cool_token(cout, curr_lineno, token, cool_yylval);
 	    }
 	    fclose(fin);
 	    optind++;
 	}
+	if (binary_format) {
+	    end_binary_tokens(tokens);
+	    tokens.write(cout, BINARY_TOKENS);
+	}
 	exit(0);
 }
 
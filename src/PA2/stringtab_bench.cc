@@ -0,0 +1,58 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  stringtab_bench.cc
+//
+//  Times the string table on the operations the compiler performs most:
+//  interning a new identifier, interning one that is already present (as
+//  the lexer does for every repeated name), and looking entries up by
+//  string and by index (as the code generator does).
+//
+//      stringtab_bench [count]
+//
+//  count defaults to 1000000 identifiers.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "stringtab.h"
+#include "bench.h"
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  char buf[32];
+
+  BenchTimer timer;
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "ident_%d", i);
+    idtable.add_string(buf);
+  }
+  timer.report("add_string (new)", n);
+
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "ident_%d", i);
+    idtable.add_string(buf);
+  }
+  timer.report("add_string (present)", n);
+
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "ident_%d", i);
+    idtable.lookup_string(buf);
+  }
+  timer.report("lookup_string", n);
+
+  int sum = 0;
+  for (int i = idtable.first(); idtable.more(i); i = idtable.next(i))
+    sum += idtable.lookup(i)->get_len();
+  timer.report("lookup (index)", n);
+
+  // Keep the last loop from being optimized away.
+  return sum == 0 && n > 0;
+}
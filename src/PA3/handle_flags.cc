@@ -30,6 +30,10 @@ extern int cool_yydebug;        // for the parser
        bool disable_reg_alloc;  // Don't do register allocation
 
        int cgen_optimize;       // optimize switch for code generator 
+       int cgen_inline_size;    // largest method body inlined under -O
+       int cgen_inline_depth;   // most calls inlined into each other
+       bool disable_tail_calls; // Don't jump to methods called last under -O
+       int binary_format;       // pass tokens/ASTs on in binary (binary-io.h)
        char *out_filename;      // file name for generated code
        Memmgr cgen_Memmgr = GC_NOGC;      // enable/disable garbage collection
        Memmgr_Test cgen_Memmgr_Test = GC_NORMAL;  // normal/test GC
@@ -51,9 +55,13 @@ void handle_flags(int argc, char *argv[]) {
   cgen_debug = 0;
   cgen_optimize = 0;
   disable_reg_alloc = 0;
+  cgen_inline_size = 16;
+  cgen_inline_depth = 2;
+  disable_tail_calls = 0;
+  binary_format = 0;
   
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt(argc, argv, "lpscvrOi:no:gtTb")) != -1) {
     switch (c) {
 #ifdef DEBUG
     case 'l':
@@ -99,6 +107,16 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'i':  // inlining budget: body size in tree nodes[,depth]; 0 for none
+      if (sscanf(optarg, "%d,%d", &cgen_inline_size, &cgen_inline_depth) < 1)
+        unknownopt = 1;
+      break;
+    case 'n':  // no tail calls under -O
+      disable_tail_calls = 1;
+      break;
+    case 'b':  // write the token stream or AST in binary
+      binary_format = 1;
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +129,9 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscOgtTrnb -i size[,depth] -o outname] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-OgtTnb -i size[,depth] -o outname] [input-files]\n";
 #endif
       exit(1);
   }
@@ -0,0 +1,56 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  list_bench.cc
+//
+//  Times the AST lists on a class with many features: building the
+//  feature list the way the parser does, one append_Features at a time;
+//  walking it with the first/more/next/nth loop used by semant and cgen;
+//  and dumping the class with dump_with_types.
+//
+//      list_bench [count]
+//
+//  count defaults to 50000 features.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cool-io.h"
+#include "cool-tree.h"
+#include "bench.h"
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 50000;
+  Symbol Int = idtable.add_string("Int");
+  char buf[32];
+
+  BenchTimer timer;
+  Features features = nil_Features();
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "a%d", i);
+    features = append_Features(features,
+      single_Features(attr(idtable.add_string(buf), Int, no_expr())));
+  }
+  Class_ c = class_(idtable.add_string("Main"), idtable.add_string("Object"),
+		    features, stringtable.add_string("bench.cl"));
+  timer.report("build", n);
+
+  int lines = 0;
+  for (int i = features->first(); features->more(i); i = features->next(i))
+    lines += features->nth(i)->get_line_number();
+  timer.report("first/more/next/nth", n);
+
+  ofstream null("/dev/null");
+  program(single_Classes(c))->dump_with_types(null, 0);
+  timer.report("dump_with_types", n);
+
+  // Keep the walk from being optimized away.
+  return lines != n;
+}
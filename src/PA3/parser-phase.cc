@@ -9,6 +9,8 @@
 //  parser-phase.cc
 //
 //  Reads a COOL token stream from a file and builds the abstract syntax tree.
+//  The token stream may be text or binary (see binary-io.h); with -b the
+//  tree is written out in binary as well.
 //
 //////////////////////////////////////////////////////////////////////////////
 
@@ -18,6 +20,7 @@
 #include "cool-tree.h"
 #include "utilities.h"  // for fatal_error
 #include "cool-parse.h"
+#include "binary-io.h"
 
 //
 // These globals keep everything working.
@@ -29,18 +32,40 @@ extern Program ast_root;	 // the AST produced by the parse
 char *curr_filename = "<stdin>";
 
 extern int omerrs;             // a count of lex and parse errors
+extern int curr_lineno;        // the line of the current token
+extern int binary_format;      // write the AST in binary
 
 extern int cool_yyparse();
 void handle_flags(int argc, char *argv[]);
 
+//
+// The text token reader in tokens-lex.cc is compiled with its entry point
+// renamed to cool_yylex_text; the parser gets its tokens from here.
+//
+extern int cool_yylex_text();
+static BinaryReader *token_reader;   // set when the input is binary
+
+int cool_yylex() {
+    if (token_reader)
+	return read_binary_token(*token_reader, curr_lineno, curr_filename,
+				 cool_yylval);
+    return cool_yylex_text();
+}
+
 int main(int argc, char *argv[]) {
     handle_flags(argc, argv);
+    if (is_binary_input(token_file))
+	token_reader = new BinaryReader(token_file, BINARY_TOKENS);
     cool_yyparse();
     if (omerrs != 0) {
 	cerr << "Compilation halted due to lex and parse errors\n";
 	exit(1);
     }
-    ast_root->dump_with_types(cout,0);
+    if (binary_format)
+	dump_binary_ast(cout, ast_root);
+    else
+	ast_root->dump_with_types(cout,0);
+    free_tree_nodes();
     return 0;
 }
 
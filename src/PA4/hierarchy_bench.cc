@@ -0,0 +1,115 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  hierarchy_bench.cc
+//
+//  Times subtype tests and least upper bounds on a synthetic hierarchy,
+//  with ClassHierarchy and with the walk up a std::map of parents that
+//  semant used before it.  The first classes form a single chain as deep
+//  as the depth limit; each of the rest inherits from a random earlier
+//  class that is not at the limit.
+//
+//      hierarchy_bench [classes [depth [queries]]]
+//
+//  The defaults are 10000 classes, depth 500 and 100000 queries.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include "hierarchy.h"
+#include "bench.h"
+
+static std::map<Symbol, Symbol> parent_of;
+
+static bool walk_is_subclass(Symbol sub, Symbol super)
+{
+  for (std::map<Symbol, Symbol>::iterator it = parent_of.find(sub);
+       it != parent_of.end(); it = parent_of.find(it->second))
+    if (it->first == super)
+      return true;
+  return false;
+}
+
+static Symbol walk_lub(Symbol a, Symbol b)
+{
+  while (!walk_is_subclass(b, a))
+    a = parent_of[a];
+  return a;
+}
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 10000;
+  int max_depth = argc > 2 ? atoi(argv[2]) : 500;
+  int queries = argc > 3 ? atoi(argv[3]) : 100000;
+  char buf[32];
+
+  std::vector<Symbol> classes;
+  std::vector<int> depth;
+  classes.push_back(idtable.add_string("Object"));
+  depth.push_back(0);
+  srand(1);
+  for (int i = 1; i < n; i++) {
+    int p = i - 1;
+    if (i > max_depth)
+      do p = rand() % i; while (depth[p] == max_depth);
+    snprintf(buf, sizeof(buf), "C%d", i);
+    classes.push_back(idtable.add_string(buf));
+    depth.push_back(depth[p] + 1);
+    parent_of[classes[i]] = classes[p];
+  }
+  parent_of[classes[0]] = idtable.add_string("_no_class");
+
+  std::vector<std::pair<Symbol, Symbol> > pairs;
+  for (int i = 0; i < queries; i++)
+    pairs.push_back(std::make_pair(classes[rand() % n], classes[rand() % n]));
+
+  BenchTimer timer;
+  ClassHierarchy h;
+  for (int i = 0; i < n; i++)
+    h.add_class(classes[i], parent_of[classes[i]]);
+  h.build();
+  timer.report("build", n);
+
+  int yes = 0;
+  for (int i = 0; i < queries; i++)
+    yes += h.is_subclass(pairs[i].first, pairs[i].second);
+  timer.report("is_subclass", queries);
+
+  int sum = 0;
+  for (int i = 0; i < queries; i++)
+    sum += h.depth(h.lub(pairs[i].first, pairs[i].second));
+  timer.report("lub", queries);
+
+  // The walks are much slower; a tenth of the queries is plenty.
+  int walk_queries = queries / 10;
+  int walk_yes = 0;
+  for (int i = 0; i < walk_queries; i++)
+    walk_yes += walk_is_subclass(pairs[i].first, pairs[i].second);
+  timer.report("map walk is_subclass", walk_queries);
+
+  int walk_sum = 0;
+  for (int i = 0; i < walk_queries; i++)
+    walk_sum += h.depth(walk_lub(pairs[i].first, pairs[i].second));
+  timer.report("map walk lub", walk_queries);
+
+  // Check the two against each other on the queries both answered.
+  int check_yes = 0, check_sum = 0;
+  for (int i = 0; i < walk_queries; i++) {
+    check_yes += h.is_subclass(pairs[i].first, pairs[i].second);
+    check_sum += h.depth(h.lub(pairs[i].first, pairs[i].second));
+  }
+  if (check_yes != walk_yes || check_sum != walk_sum) {
+    printf("mismatch\n");
+    return 1;
+  }
+  return yes < 0 || sum < 0;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "cool-tree.h"
+#include "binary-io.h"
 
 extern Program ast_root;      // root of the abstract syntax tree
 FILE *ast_file = stdin;       // we read the AST from standard input
@@ -7,13 +8,21 @@ extern int ast_yyparse(void); // entry point to the AST parser
 
 int cool_yydebug;     // not used, but needed to link with handle_flags
 char *curr_filename;
+extern int binary_format;     // write the AST in binary
 
 void handle_flags(int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
   handle_flags(argc,argv);
-  ast_yyparse();
+  if (is_binary_input(ast_file))
+    ast_root = read_binary_ast(ast_file);
+  else
+    ast_yyparse();
   ast_root->semant();
-  ast_root->dump_with_types(cout,0);
+  if (binary_format)
+    dump_binary_ast(cout, ast_root);
+  else
+    ast_root->dump_with_types(cout,0);
+  free_tree_nodes();
 }
 
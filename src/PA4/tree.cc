@@ -18,6 +18,54 @@
 /* line number to assign to the current node being constructed */
 int node_lineno = 1;
 
+/* where all tree nodes are allocated */
+Arena tree_arena;
+static int tree_nodes;
+
+/* the counts at the last print_tree_stats */
+static int last_nodes;
+static size_t last_bytes;
+
+///////////////////////////////////////////////////////////////////////////
+//
+// tree_node::operator new
+//
+///////////////////////////////////////////////////////////////////////////
+void *tree_node::operator new(size_t size)
+{
+    tree_nodes++;
+    return tree_arena.alloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// free_tree_nodes
+//
+// release the whole arena; the nodes' destructors are not run
+//
+///////////////////////////////////////////////////////////////////////////
+void free_tree_nodes()
+{
+    tree_arena.release();
+    tree_nodes = last_nodes = 0;
+    last_bytes = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// print_tree_stats
+//
+///////////////////////////////////////////////////////////////////////////
+void print_tree_stats(ostream& s, const char *phase)
+{
+    s << phase << ": " << tree_nodes - last_nodes << " tree nodes, "
+      << tree_arena.num_bytes() - last_bytes << " bytes; in all "
+      << tree_nodes << " nodes, " << tree_arena.num_bytes() << " bytes in "
+      << tree_arena.num_chunks() << " arena chunks" << endl;
+    last_nodes = tree_nodes;
+    last_bytes = tree_arena.num_bytes();
+}
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // tree_node::tree_node
@@ -0,0 +1,571 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ast-binary.cc
+//
+//  Writes and reads the AST in the binary format of binary-io.h.  This is
+//  the binary counterpart of dump_with_types in dumptype.cc and of the
+//  text AST reader in ast-lex.cc/ast-parse.cc.
+//
+//  Every node is written in preorder as its constructor tag and line
+//  number, then its components in the order of the constructor's
+//  arguments, then (for expressions) its type.  A list is its length
+//  followed by its elements.  Identifiers refer to idtable, integer
+//  constants to inttable, and string constants and class file names to
+//  stringtable, just as in the text format.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "cool.h"
+#include "tree.h"
+#include "cool-tree.h"
+#include "utilities.h"
+#include "binary-io.h"
+
+extern int node_lineno;   // the line number given to new tree nodes
+
+enum {
+   TAG_program = 1,
+   TAG_class_,
+   TAG_method,
+   TAG_attr,
+   TAG_formal,
+   TAG_branch,
+   TAG_assign,
+   TAG_static_dispatch,
+   TAG_dispatch,
+   TAG_cond,
+   TAG_loop,
+   TAG_typcase,
+   TAG_block,
+   TAG_let,
+   TAG_plus,
+   TAG_sub,
+   TAG_mul,
+   TAG_divide,
+   TAG_neg,
+   TAG_lt,
+   TAG_eq,
+   TAG_leq,
+   TAG_comp,
+   TAG_int_const,
+   TAG_bool_const,
+   TAG_string_const,
+   TAG_new_,
+   TAG_isvoid,
+   TAG_no_expr,
+   TAG_object
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Writing
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void dump_binary_node(BinaryWriter& w, int tag, tree_node *t)
+{
+   w.put_byte(tag);
+   w.put_int(t->get_line_number());
+}
+
+template <class Elem>
+static void dump_binary_list(BinaryWriter& w, list_node<Elem> *l)
+{
+   w.put_int(l->len());
+   for(int i = l->first(); l->more(i); i = l->next(i))
+     l->nth(i)->dump_binary(w);
+}
+
+void dump_binary_ast(ostream& s, Program root)
+{
+   BinaryWriter w;
+   root->dump_binary(w);
+   w.write(s, BINARY_AST);
+}
+
+void program_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_program, this);
+   dump_binary_list(w, classes);
+}
+
+void class__class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_class_, this);
+   w.put_id(name);
+   w.put_id(parent);
+   dump_binary_list(w, features);
+   w.put_str(filename);
+}
+
+void method_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_method, this);
+   w.put_id(name);
+   dump_binary_list(w, formals);
+   w.put_id(return_type);
+   expr->dump_binary(w);
+}
+
+void attr_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_attr, this);
+   w.put_id(name);
+   w.put_id(type_decl);
+   init->dump_binary(w);
+}
+
+void formal_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_formal, this);
+   w.put_id(name);
+   w.put_id(type_decl);
+}
+
+void branch_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_branch, this);
+   w.put_id(name);
+   w.put_id(type_decl);
+   expr->dump_binary(w);
+}
+
+void assign_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_assign, this);
+   w.put_id(name);
+   expr->dump_binary(w);
+   w.put_id(type);
+}
+
+void static_dispatch_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_static_dispatch, this);
+   expr->dump_binary(w);
+   w.put_id(type_name);
+   w.put_id(name);
+   dump_binary_list(w, actual);
+   w.put_id(type);
+}
+
+void dispatch_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_dispatch, this);
+   expr->dump_binary(w);
+   w.put_id(name);
+   dump_binary_list(w, actual);
+   w.put_id(type);
+}
+
+void cond_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_cond, this);
+   pred->dump_binary(w);
+   then_exp->dump_binary(w);
+   else_exp->dump_binary(w);
+   w.put_id(type);
+}
+
+void loop_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_loop, this);
+   pred->dump_binary(w);
+   body->dump_binary(w);
+   w.put_id(type);
+}
+
+void typcase_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_typcase, this);
+   expr->dump_binary(w);
+   dump_binary_list(w, cases);
+   w.put_id(type);
+}
+
+void block_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_block, this);
+   dump_binary_list(w, body);
+   w.put_id(type);
+}
+
+void let_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_let, this);
+   w.put_id(identifier);
+   w.put_id(type_decl);
+   init->dump_binary(w);
+   body->dump_binary(w);
+   w.put_id(type);
+}
+
+void plus_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_plus, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void sub_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_sub, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void mul_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_mul, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void divide_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_divide, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void neg_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_neg, this);
+   e1->dump_binary(w);
+   w.put_id(type);
+}
+
+void lt_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_lt, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void eq_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_eq, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void leq_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_leq, this);
+   e1->dump_binary(w);
+   e2->dump_binary(w);
+   w.put_id(type);
+}
+
+void comp_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_comp, this);
+   e1->dump_binary(w);
+   w.put_id(type);
+}
+
+void int_const_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_int_const, this);
+   w.put_int_const(token);
+   w.put_id(type);
+}
+
+void bool_const_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_bool_const, this);
+   w.put_byte(val);
+   w.put_id(type);
+}
+
+void string_const_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_string_const, this);
+   w.put_str(token);
+   w.put_id(type);
+}
+
+void new__class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_new_, this);
+   w.put_id(type_name);
+   w.put_id(type);
+}
+
+void isvoid_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_isvoid, this);
+   e1->dump_binary(w);
+   w.put_id(type);
+}
+
+void no_expr_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_no_expr, this);
+   w.put_id(type);
+}
+
+void object_class::dump_binary(BinaryWriter& w)
+{
+   dump_binary_node(w, TAG_object, this);
+   w.put_id(name);
+   w.put_id(type);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Reading
+//
+//  Each read_ function consumes one node, building its components before
+//  the node itself, and so has to set node_lineno just before the node's
+//  constructor runs.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void bad_tag(int tag)
+{
+   cerr << "Unexpected node " << tag << " in binary AST" << endl;
+   exit(1);
+}
+
+static Expression read_expression(BinaryReader& r);
+
+static int read_tag(BinaryReader& r, int expected, int& line)
+{
+   int tag = r.get_byte();
+   if (expected && tag != expected)
+     bad_tag(tag);
+   line = r.get_int();
+   return tag;
+}
+
+static Formal read_formal(BinaryReader& r)
+{
+   int line;
+   read_tag(r, TAG_formal, line);
+   Symbol name = r.get_id();
+   Symbol type_decl = r.get_id();
+   node_lineno = line;
+   return formal(name, type_decl);
+}
+
+static Case read_case(BinaryReader& r)
+{
+   int line;
+   read_tag(r, TAG_branch, line);
+   Symbol name = r.get_id();
+   Symbol type_decl = r.get_id();
+   Expression expr = read_expression(r);
+   node_lineno = line;
+   return branch(name, type_decl, expr);
+}
+
+static Formals read_formals(BinaryReader& r)
+{
+   Formals l = nil_Formals();
+   for (unsigned int n = r.get_int(); n > 0; n--)
+     l = append_Formals(l, single_Formals(read_formal(r)));
+   return l;
+}
+
+static Cases read_cases(BinaryReader& r)
+{
+   Cases l = nil_Cases();
+   for (unsigned int n = r.get_int(); n > 0; n--)
+     l = append_Cases(l, single_Cases(read_case(r)));
+   return l;
+}
+
+static Expressions read_expressions(BinaryReader& r)
+{
+   Expressions l = nil_Expressions();
+   for (unsigned int n = r.get_int(); n > 0; n--)
+     l = append_Expressions(l, single_Expressions(read_expression(r)));
+   return l;
+}
+
+static Expression read_expression(BinaryReader& r)
+{
+   int line;
+   int tag = read_tag(r, 0, line);
+   Expression e, e1, e2, e3;
+   Symbol s1, s2;
+
+   switch (tag) {
+   case TAG_assign:
+     s1 = r.get_id();
+     e1 = read_expression(r);
+     node_lineno = line;
+     e = assign(s1, e1);
+     break;
+   case TAG_static_dispatch: {
+     e1 = read_expression(r);
+     s1 = r.get_id();
+     s2 = r.get_id();
+     Expressions actual = read_expressions(r);
+     node_lineno = line;
+     e = static_dispatch(e1, s1, s2, actual);
+     break;
+   }
+   case TAG_dispatch: {
+     e1 = read_expression(r);
+     s1 = r.get_id();
+     Expressions actual = read_expressions(r);
+     node_lineno = line;
+     e = dispatch(e1, s1, actual);
+     break;
+   }
+   case TAG_cond:
+     e1 = read_expression(r);
+     e2 = read_expression(r);
+     e3 = read_expression(r);
+     node_lineno = line;
+     e = cond(e1, e2, e3);
+     break;
+   case TAG_loop:
+     e1 = read_expression(r);
+     e2 = read_expression(r);
+     node_lineno = line;
+     e = loop(e1, e2);
+     break;
+   case TAG_typcase: {
+     e1 = read_expression(r);
+     Cases cases = read_cases(r);
+     node_lineno = line;
+     e = typcase(e1, cases);
+     break;
+   }
+   case TAG_block: {
+     Expressions body = read_expressions(r);
+     node_lineno = line;
+     e = block(body);
+     break;
+   }
+   case TAG_let:
+     s1 = r.get_id();
+     s2 = r.get_id();
+     e1 = read_expression(r);
+     e2 = read_expression(r);
+     node_lineno = line;
+     e = let(s1, s2, e1, e2);
+     break;
+   case TAG_plus:
+   case TAG_sub:
+   case TAG_mul:
+   case TAG_divide:
+   case TAG_lt:
+   case TAG_eq:
+   case TAG_leq:
+     e1 = read_expression(r);
+     e2 = read_expression(r);
+     node_lineno = line;
+     switch (tag) {
+     case TAG_plus:   e = plus(e1, e2); break;
+     case TAG_sub:    e = sub(e1, e2); break;
+     case TAG_mul:    e = mul(e1, e2); break;
+     case TAG_divide: e = divide(e1, e2); break;
+     case TAG_lt:     e = lt(e1, e2); break;
+     case TAG_eq:     e = eq(e1, e2); break;
+     default:         e = leq(e1, e2); break;
+     }
+     break;
+   case TAG_neg:
+   case TAG_comp:
+   case TAG_isvoid:
+     e1 = read_expression(r);
+     node_lineno = line;
+     switch (tag) {
+     case TAG_neg:  e = neg(e1); break;
+     case TAG_comp: e = comp(e1); break;
+     default:       e = isvoid(e1); break;
+     }
+     break;
+   case TAG_int_const:
+     node_lineno = line;
+     e = int_const(r.get_int_const());
+     break;
+   case TAG_bool_const:
+     node_lineno = line;
+     e = bool_const(r.get_byte());
+     break;
+   case TAG_string_const:
+     node_lineno = line;
+     e = string_const(r.get_str());
+     break;
+   case TAG_new_:
+     node_lineno = line;
+     e = new_(r.get_id());
+     break;
+   case TAG_no_expr:
+     node_lineno = line;
+     e = no_expr();
+     break;
+   case TAG_object:
+     node_lineno = line;
+     e = object(r.get_id());
+     break;
+   default:
+     bad_tag(tag);
+   }
+   return e->set_type(r.get_id());
+}
+
+static Feature read_feature(BinaryReader& r)
+{
+   int line;
+   int tag = read_tag(r, 0, line);
+   Symbol name = r.get_id();
+
+   if (tag == TAG_method) {
+     Formals formals = read_formals(r);
+     Symbol return_type = r.get_id();
+     Expression expr = read_expression(r);
+     node_lineno = line;
+     return method(name, formals, return_type, expr);
+   }
+   if (tag != TAG_attr)
+     bad_tag(tag);
+   Symbol type_decl = r.get_id();
+   Expression init = read_expression(r);
+   node_lineno = line;
+   return attr(name, type_decl, init);
+}
+
+static Class_ read_class(BinaryReader& r)
+{
+   int line;
+   read_tag(r, TAG_class_, line);
+   Symbol name = r.get_id();
+   Symbol parent = r.get_id();
+   Features features = nil_Features();
+   for (unsigned int n = r.get_int(); n > 0; n--)
+     features = append_Features(features, single_Features(read_feature(r)));
+   Symbol filename = r.get_str();
+   node_lineno = line;
+   return class_(name, parent, features, filename);
+}
+
+Program read_binary_ast(FILE *f)
+{
+   BinaryReader r(f, BINARY_AST);
+   int line;
+   read_tag(r, TAG_program, line);
+   Classes classes = nil_Classes();
+   for (unsigned int n = r.get_int(); n > 0; n--)
+     classes = append_Classes(classes, single_Classes(read_class(r)));
+   if (!r.at_end())
+     bad_tag(r.get_byte());
+   node_lineno = line;
+   return program(classes);
+}
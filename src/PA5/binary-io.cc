@@ -0,0 +1,337 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  binary-io.cc
+//
+//  The binary interchange format described in binary-io.h: the writer and
+//  reader shared by all phases, and the encoding of the token stream.  The
+//  encoding of the AST is in ast-binary.cc.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cool-parse.h"
+#include "utilities.h"
+#include "binary-io.h"
+
+static const char magic[] = "\177COOL";
+#define MAGIC_LEN     5
+#define HEADER_LEN    (MAGIC_LEN + 2)
+#define VERSION       1
+
+// The pseudo-token that marks a file name in a token stream; real tokens
+// are either characters or bison token numbers above 255.
+#define FILE_NAME_MARK 1
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  BinaryWriter
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void append_int(std::string& out, unsigned int n)
+{
+  while (n >= 0x80) {
+    out += (char) ((n & 0x7f) | 0x80);
+    n >>= 7;
+  }
+  out += (char) n;
+}
+
+static void append_chars(std::string& out, const char *s, int len)
+{
+  append_int(out, len);
+  out.append(s, len);
+  out += '\0';
+}
+
+void BinaryWriter::put_int(unsigned int n)
+{
+  append_int(body, n);
+}
+
+void BinaryWriter::put_chars(const char *s, int len)
+{
+  append_chars(body, s, len);
+}
+
+void BinaryWriter::put_symbol(std::map<Symbol, int>& index,
+			      std::vector<Symbol>& order, Symbol s)
+{
+  if (s == NULL) {
+    put_int(0);
+    return;
+  }
+  std::map<Symbol, int>::iterator it = index.find(s);
+  if (it == index.end()) {
+    it = index.insert(std::make_pair(s, (int) order.size())).first;
+    order.push_back(s);
+  }
+  put_int(it->second + 1);
+}
+
+void BinaryWriter::put_table(std::string& out, std::vector<Symbol>& order)
+{
+  append_int(out, order.size());
+  for (size_t i = 0; i < order.size(); i++)
+    append_chars(out, order[i]->get_string(), order[i]->get_len());
+}
+
+void BinaryWriter::write(ostream& s, char kind)
+{
+  std::string head(magic, MAGIC_LEN);
+  head += kind;
+  head += (char) VERSION;
+
+  std::string symbols;
+  put_table(symbols, ids);
+  put_table(symbols, strs);
+  put_table(symbols, ints);
+  append_int(head, symbols.size());
+  s.write(head.data(), head.size());
+  s.write(symbols.data(), symbols.size());
+
+  std::string length;
+  append_int(length, body.size());
+  s.write(length.data(), length.size());
+  s.write(body.data(), body.size());
+  s.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  BinaryReader
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool is_binary_input(FILE *f)
+{
+  int c = getc(f);
+  if (c == EOF)
+    return false;
+  ungetc(c, f);
+  return c == magic[0];
+}
+
+BinaryReader::BinaryReader(FILE *f, char kind) : data(NULL), size(0), mapped(false)
+{
+  struct stat st;
+  int fd = fileno(f);
+
+  // Map regular files; anything else (usually a pipe from the previous
+  // phase) is read into memory.
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      data = (const unsigned char *) p;
+      size = st.st_size;
+      mapped = true;
+    }
+  }
+  if (!mapped) {
+    size_t cap = 1 << 16;
+    unsigned char *buf = (unsigned char *) malloc(cap);
+    size_t n;
+    while (buf != NULL && (n = fread(buf + size, 1, cap - size, f)) > 0) {
+      size += n;
+      if (size == cap)
+	buf = (unsigned char *) realloc(buf, cap *= 2);
+    }
+    if (buf == NULL) {
+      cerr << "Out of memory for the binary input" << endl;
+      exit(1);
+    }
+    data = buf;
+  }
+
+  cur = data;
+  end = data + size;
+  if (size < HEADER_LEN || memcmp(data, magic, MAGIC_LEN) != 0 ||
+      data[MAGIC_LEN] != kind || data[MAGIC_LEN + 1] != VERSION) {
+    cerr << "Input is not a binary " <<
+      (kind == BINARY_TOKENS ? "token stream" : "AST") << endl;
+    exit(1);
+  }
+  cur += HEADER_LEN;
+
+  const unsigned char *symbols_end;
+  unsigned int length = get_int();
+  if (length > (size_t) (end - cur))
+    truncated();
+  symbols_end = cur + length;
+  get_table(ids, 'I');
+  get_table(strs, 'S');
+  get_table(ints, 'N');
+  if (cur != symbols_end)
+    truncated();
+
+  length = get_int();
+  if (length != (size_t) (end - cur))
+    truncated();
+}
+
+BinaryReader::~BinaryReader()
+{
+  if (mapped)
+    munmap((void *) data, size);
+  else
+    free((void *) data);
+}
+
+void BinaryReader::truncated()
+{
+  cerr << "Binary input is truncated or corrupt" << endl;
+  exit(1);
+}
+
+int BinaryReader::get_byte()
+{
+  if (cur == end)
+    truncated();
+  return *cur++;
+}
+
+unsigned int BinaryReader::get_int()
+{
+  unsigned int n = 0;
+  int shift = 0;
+  int b;
+  do {
+    b = get_byte();
+    // the fifth byte holds the top 4 bits and is the last
+    if (shift == 28 && b > 0x0f)
+      truncated();
+    n |= (unsigned int) (b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+  return n;
+}
+
+char *BinaryReader::get_chars()
+{
+  unsigned int len = get_int();
+  if (len >= (size_t) (end - cur) || cur[len] != '\0')
+    truncated();
+  char *s = new char[len + 1];
+  memcpy(s, cur, len + 1);
+  cur += len + 1;
+  return s;
+}
+
+//
+// The strings in the symbol section are '\0'-terminated, so they are
+// interned straight out of the input buffer.
+//
+void BinaryReader::get_table(std::vector<Symbol>& out, int kind)
+{
+  unsigned int count = get_int();
+  out.reserve(count);
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int len = get_int();
+    if (len >= (size_t) (end - cur) || cur[len] != '\0')
+      truncated();
+    char *s = (char *) cur;
+    switch (kind) {
+    case 'I': out.push_back(idtable.add_string(s, len)); break;
+    case 'S': out.push_back(stringtable.add_string(s, len)); break;
+    case 'N': out.push_back(inttable.add_string(s, len)); break;
+    }
+    cur += len + 1;
+  }
+}
+
+Symbol BinaryReader::get_symbol(std::vector<Symbol>& table)
+{
+  unsigned int i = get_int();
+  if (i == 0)
+    return NULL;
+  if (i > table.size())
+    truncated();
+  return table[i - 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Token streams
+//
+//  Each token is its number and line, followed by its semantic value for
+//  the tokens that have one.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void dump_binary_file_name(BinaryWriter& w, char *name)
+{
+  w.put_int(FILE_NAME_MARK);
+  w.put_chars(name, strlen(name));
+}
+
+void dump_binary_token(BinaryWriter& w, int lineno, int token, YYSTYPE& yylval)
+{
+  w.put_int(token);
+  w.put_int(lineno);
+
+  switch (token) {
+  case STR_CONST:
+    w.put_str(yylval.symbol);
+    break;
+  case INT_CONST:
+    w.put_int_const(yylval.symbol);
+    break;
+  case BOOL_CONST:
+    w.put_byte(yylval.boolean);
+    break;
+  case TYPEID:
+  case OBJECTID:
+    w.put_id(yylval.symbol);
+    break;
+  case ERROR:
+    w.put_chars(yylval.error_msg, strlen(yylval.error_msg));
+    break;
+  }
+}
+
+void end_binary_tokens(BinaryWriter& w)
+{
+  w.put_int(0);
+}
+
+int read_binary_token(BinaryReader& r, int& lineno, char *&filename,
+		      YYSTYPE& yylval)
+{
+  int token;
+
+  while ((token = r.get_int()) == FILE_NAME_MARK)
+    filename = r.get_chars();
+  if (token == 0)
+    return 0;
+
+  lineno = r.get_int();
+  switch (token) {
+  case STR_CONST:
+    yylval.symbol = r.get_str();
+    break;
+  case INT_CONST:
+    yylval.symbol = r.get_int_const();
+    break;
+  case BOOL_CONST:
+    yylval.boolean = r.get_byte();
+    break;
+  case TYPEID:
+  case OBJECTID:
+    yylval.symbol = r.get_id();
+    break;
+  case ERROR:
+    yylval.error_msg = r.get_chars();
+    break;
+  }
+  return token;
+}
@@ -4,6 +4,7 @@
 #include "cool-io.h"  //includes iostream
 #include "cool-tree.h"
 #include "cgen_gc.h"
+#include "binary-io.h"
 
 extern int optind;            // for option processing
 extern char *out_filename;    // name of output assembly
@@ -34,7 +35,10 @@ int main(int argc, char *argv[]) {
   // Don't touch the output file until we know that earlier phases of the
   // compiler have succeeded.
   //
-  ast_yyparse();
+  if (is_binary_input(ast_file))
+      ast_root = read_binary_ast(ast_file);
+  else
+      ast_yyparse();
 
   if (out_filename) {
       ofstream s(out_filename);
@@ -46,5 +50,6 @@ int main(int argc, char *argv[]) {
   } else {
       ast_root->cgen(cout);
   }
+  free_tree_nodes();
 }
 
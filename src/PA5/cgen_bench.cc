@@ -0,0 +1,139 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  cgen_bench.cc
+//
+//  Measures how fast the code generator produces assembly.  It builds a
+//  program with the given number of classes, in inheritance chains of
+//  20, each with an attribute and a method that does some arithmetic,
+//  and a Main class whose methods make the given number of calls to
+//  them.  The program is type checked with semant and then compiled to
+//  /dev/null, and only the code generation is timed.
+//
+//      cgen_bench [classes [calls]]
+//
+//  The defaults are 5000 classes and 200000 calls.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "cool-io.h"
+#include "cool-tree.h"
+
+int cool_yydebug;              // Not used, but needed to link with handle_flags
+FILE *ast_file = stdin;        // and with the AST reader.
+char *curr_filename = "bench.cl";
+
+// Passes everything through to another stream buffer, counting the bytes.
+class CountingBuf : public std::streambuf
+{
+public:
+  std::streambuf *out;
+  long bytes;
+
+  CountingBuf(std::streambuf *o) : out(o), bytes(0) { }
+
+protected:
+  int_type overflow(int_type c)
+  {
+    if (c == traits_type::eof())
+      return traits_type::not_eof(c);
+    bytes++;
+    return out->sputc(c);
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n)
+  {
+    bytes += n;
+    return out->sputn(s, n);
+  }
+
+  int sync()                   { return out->pubsync(); }
+};
+
+static Symbol sym(const char *fmt, int n)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), fmt, n);
+  return idtable.add_string(buf);
+}
+
+static Expression int_expr(int n)
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", n);
+  return int_const(inttable.add_string(buf));
+}
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 5000;
+  int calls = argc > 2 ? atoi(argv[2]) : 200000;
+  Symbol Int = idtable.add_string("Int");
+  Symbol Object = idtable.add_string("Object");
+  Symbol x = idtable.add_string("x");
+  Symbol y = idtable.add_string("y");
+  Symbol filename = stringtable.add_string(curr_filename);
+
+  // class Ci inherits C(i-1) {
+  //   ai : Int <- i;
+  //   mi(x : Int) : Int { if x < ai then x + ai else let y : Int <- x * 2 in y - ai fi };
+  // };
+  Classes classes = nil_Classes();
+  for (int i = 0; i < n; i++) {
+    Symbol a = sym("a%d", i);
+    Expression body =
+      cond(lt(object(x), object(a)),
+	   plus(object(x), object(a)),
+	   let(y, Int, mul(object(x), int_expr(2)), sub(object(y), object(a))));
+    Features features =
+      append_Features(single_Features(attr(a, Int, int_expr(i))),
+		      single_Features(method(sym("m%d", i), single_Formals(formal(x, Int)),
+					     Int, body)));
+    Symbol parent = i % 20 ? sym("C%d", i - 1) : Object;
+    classes = append_Classes(classes,
+      single_Classes(class_(sym("C%d", i), parent, features, filename)));
+  }
+
+  // Main's methods call a method of a class or of one of its ancestors,
+  // 1000 calls to a method.
+  Features main_features =
+    single_Features(method(idtable.add_string("main"), nil_Formals(), Object, int_expr(0)));
+  for (int k = 0; k < calls; ) {
+    Expressions body = nil_Expressions();
+    int j;
+    for (j = 0; j < 1000 && k < calls; j++, k++) {
+      int c = (int) ((k * 7919L) % n);
+      int m = c - k % (c % 20 + 1);
+      body = append_Expressions(body,
+	single_Expressions(dispatch(new_(sym("C%d", c)), sym("m%d", m),
+				    single_Expressions(int_expr(j)))));
+    }
+    main_features = append_Features(main_features,
+      single_Features(method(sym("f%d", k), nil_Formals(), Int, block(body))));
+  }
+  classes = append_Classes(classes,
+    single_Classes(class_(idtable.add_string("Main"), Object, main_features, filename)));
+
+  Program p = program(classes);
+  p->semant();
+
+  ofstream null("/dev/null");
+  CountingBuf counter(null.rdbuf());
+  ostream out(&counter);
+  clock_t start = clock();
+  p->cgen(out);
+  double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+  double bytes = counter.bytes;
+
+  printf("%d classes %d calls: %.0f bytes in %.3f s, %.1f MB/s\n",
+	 n, calls, bytes, secs, secs > 0 ? bytes / secs / 1e6 : 0.0);
+  return 0;
+}
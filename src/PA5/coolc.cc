@@ -0,0 +1,134 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  coolc.cc
+//
+//  Runs all four phases of the compiler in one process.  The scanner
+//  hands tokens straight to the parser, and the tree the parser builds is
+//  passed to the semantic checker and then to the code generator without
+//  being dumped and read back in between.
+//
+//  The separate lexer/parser/semant/cgen binaries (see mycoolc) are still
+//  built for debugging a single phase.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include "cool-io.h"  //includes iostream
+#include "cool-tree.h"
+#include "cool-parse.h"
+#include "utilities.h"
+#include "cgen_gc.h"
+
+extern int optind;            // for option processing
+extern char *out_filename;    // name of output assembly
+extern Program ast_root;      // root of the abstract syntax tree
+extern int omerrs;            // a count of lex and parse errors
+extern int lex_verbose;       // print tokens as they are scanned
+
+extern int cool_yyparse();
+
+// defined in utilities.cc
+extern void dump_cool_token(ostream& out, int lineno,
+			    int token, YYSTYPE yylval);
+
+//
+// The flex scanner.  cool-lex.o is compiled with its entry point renamed
+// to cool_yylex_file so that cool_yylex below can sit between it and the
+// parser and walk through the input files.
+//
+extern int cool_yylex_file();
+extern void yyrestart(FILE *);
+
+//
+// The lexer and parser share these with us.  curr_lineno is defined by
+// the parser, which uses it as its token location.
+//
+extern int curr_lineno;
+char *curr_filename = "<stdin>";
+FILE *fin;                    // the file the scanner is reading
+
+static char **input_files;
+static int num_input_files;
+static int next_input_file;
+
+void handle_flags(int argc, char *argv[]);
+
+//
+// Returns the next token of the concatenated input files, or 0 once the
+// last one is exhausted.  Each file is scanned from a fresh scanner state
+// and line 1, just as the stand-alone lexer does.
+//
+int cool_yylex() {
+    int token;
+
+    while (fin == NULL || (token = cool_yylex_file()) == 0) {
+	if (fin) {
+	    fclose(fin);
+	    fin = NULL;
+	}
+	if (next_input_file == num_input_files)
+	    return 0;
+
+	curr_filename = input_files[next_input_file++];
+	fin = fopen(curr_filename, "r");
+	if (fin == NULL) {
+	    cerr << "Could not open input file " << curr_filename << endl;
+	    exit(1);
+	}
+	curr_lineno = 1;
+	yyrestart(fin);
+    }
+
+    if (lex_verbose)
+	dump_cool_token(cerr, curr_lineno, token, cool_yylval);
+    return token;
+}
+
+int main(int argc, char *argv[]) {
+    handle_flags(argc, argv);
+    input_files = argv + optind;
+    num_input_files = argc - optind;
+
+    if (!out_filename && num_input_files > 0) {   // no -o option
+	char *first = input_files[0];
+	char *dot = strrchr(first, '.');
+	int len = dot ? dot - first : strlen(first);
+	out_filename = new char[len + 3];
+	strncpy(out_filename, first, len);
+	strcpy(out_filename + len, ".s");
+    }
+
+    cool_yyparse();
+    if (omerrs != 0) {
+	cerr << "Compilation halted due to lex and parse errors\n";
+	exit(1);
+    }
+
+    // semant() exits on its own if the program has static errors.
+    ast_root->semant();
+
+    //
+    // Don't touch the output file until we know that earlier phases of the
+    // compiler have succeeded.
+    //
+    if (out_filename) {
+	ofstream s(out_filename);
+	if (!s) {
+	    cerr << "Cannot open output file " << out_filename << endl;
+	    exit(1);
+	}
+	ast_root->cgen(s);
+    } else {
+	ast_root->cgen(cout);
+    }
+    free_tree_nodes();
+    return 0;
+}
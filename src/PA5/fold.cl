@@ -0,0 +1,93 @@
+(*
+ *  Prints what the expressions constant folding rewrites under -O come
+ *  to, one per line.  The output has to be the same with and without
+ *  -O, and with the collectors (see fold_test in the Makefile), down to
+ *  which objects = on Objects finds to be the same.
+ *)
+
+class Holder {
+    k : Int <- 2 * 3;
+
+    get() : Int { k };
+};
+
+class Main inherits IO {
+    two : Int <- 2;
+    seven : Int <- 7;
+
+    int(name : String, n : Int) : Object {
+        out_string(name).out_string(" ").out_int(n).out_string("\n")
+    };
+
+    bool(name : String, b : Bool) : Object {
+        out_string(name).out_string(if b then " true\n" else " false\n" fi)
+    };
+
+    main() : Object {
+        {
+            -- arithmetic, with * wrapping around and / rounding toward 0
+            int("add", 1 + 2);
+            int("sub", 1 - 5);
+            int("mul", 6 * 7);
+            int("wrap", 65536 * 65536);
+            int("wrap2", 2147483647 * 2);
+            int("div", 7 / 2);
+            int("divneg", ~7 / 2);
+            int("divneg2", 7 / ~2);
+            int("neg", ~(3 + 4));
+            int("nested", (1 + 2) * (3 + 4) - 10 / 3);
+
+            -- comparisons, not and isvoid
+            bool("lt", 1 < 2);
+            bool("lt2", 2 < 1);
+            bool("leq", 2 <= 2);
+            bool("leq2", 3 <= 2);
+            bool("eqint", 2 + 2 = 4);
+            bool("eqint2", 2 + 2 = 5);
+            bool("eqbool", true = not false);
+            bool("eqstr", "a" = "a");
+            bool("eqstr2", "a" = "b");
+            bool("not", not (1 < 2));
+            bool("isvoid", isvoid 3);
+
+            -- let variables, assigned and shadowed ones included
+            let x : Int <- 5 in int("let", x * x + 1);
+            let x : Int <- 5 in { x <- x + 1; int("letassign", x * 2); };
+            let x : Int <- 5 in let x : Int <- x + 1 in int("shadow", x * 10);
+            let x : Int <- 5 in case 1 of x : Int => int("case", x + 1); esac;
+            let x : Int <- 2 * 3 in int("letfold", x + 1);
+
+            -- ifs with constant predicates
+            int("if", if 1 < 2 then 10 else 20 fi);
+            int("if2", if 2 < 1 then 10 else 20 fi);
+            case (if true then 1 else "s" fi) of
+                i : Int => int("ifcase", i);
+                s : String => int("ifcase", 0);
+            esac;
+
+            -- multiplication and division by powers of 2 at run time
+            int("mulpow", seven * 4);
+            int("divpow", seven / 4);
+            int("divpowneg", ~seven / 4);
+            int("mulone", seven * 1);
+            int("divone", seven / 1);
+            int("mulbig", two * 1073741824);
+
+            -- folded arithmetic is a new Int object, a literal is not
+            bool("idfold", let a : Object <- 2 * 3, b : Object <- 6 in a = b);
+            bool("idlit", let a : Object <- 6, b : Object <- 6 in a = b);
+            bool("idsame", let a : Object <- 2 * 3 in a = a);
+            bool("idtwo", let a : Object <- 2 * 3, b : Object <- 2 * 3 in a = b);
+            bool("idvar", let x : Int <- 2 * 3 in
+                              let a : Object <- x, b : Object <- x in a = b);
+            bool("idvar2", let x : Int <- 2 * 3 in
+                               let a : Object <- x, b : Object <- 6 in a = b);
+            bool("idattr", let h : Holder <- new Holder, g : Holder <- new Holder in
+                               let a : Object <- h.get(), b : Object <- g.get() in a = b);
+            bool("idif", (if true then 2 * 3 else "s" fi) = (if true then 6 else "s" fi));
+            bool("idif2", (if true then 6 else "s" fi) = (if true then 6 else "s" fi));
+            bool("idvalue", let a : Object <- 2 * 3 in
+                                case a of i : Int => i = 6; o : Object => false; esac);
+        }
+    };
+};
@@ -18,10 +18,21 @@ template class StringTable<IdEntry>;
 template class StringTable<StringEntry>;
 template class StringTable<IntEntry>;
 
-Entry::Entry(char *s, int l, int i) : len(l), index(i) {
-  str = new char [len+1];
-  strncpy(str, s, len);
-  str[len] = '\0';
+Entry::Entry(char *s, int l, int i) : str(s), len(l), index(i) {
+  hash = hash_string(str, len);
+}
+
+//
+// 32-bit FNV-1a.
+//
+unsigned int Entry::hash_string(const char *s, int len)
+{
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
 }
 
 int Entry::equal_string(char *string, int length) const
@@ -74,6 +85,61 @@ StringEntry::StringEntry(char *s, int l, int i) : Entry(s,l,i) { }
 IdEntry::IdEntry(char *s, int l, int i) : Entry(s,l,i) { }
 IntEntry::IntEntry(char *s, int l, int i) : Entry(s,l,i) { }
 
+#define CHUNK_SIZE 65536
+
+Arena::~Arena()
+{
+  release();
+}
+
+void Arena::release()
+{
+  for (size_t i = 0; i < chunks.size(); i++)
+    delete [] chunks[i];
+  chunks.clear();
+  chunk = NULL;
+  used = size = 0;
+  allocs = 0;
+  bytes = reserved = 0;
+}
+
+//
+// Requests that would waste much of a fresh chunk get a chunk of their
+// own; the current chunk is kept for the requests after them.
+//
+void *Arena::alloc(size_t n, size_t align)
+{
+  allocs++;
+  bytes += n;
+
+  size_t start = (used + align - 1) & ~(align - 1);
+  if (chunk != NULL && start + n <= size) {
+    used = start + n;
+    return chunk + start;
+  }
+
+  // new[] memory is aligned for any type, so offset 0 always suffices.
+  if (n > CHUNK_SIZE / 4) {
+    char *big = new char[n];
+    chunks.push_back(big);
+    reserved += n;
+    return big;
+  }
+  chunk = new char[CHUNK_SIZE];
+  chunks.push_back(chunk);
+  reserved += CHUNK_SIZE;
+  size = CHUNK_SIZE;
+  used = n;
+  return chunk;
+}
+
 IdTable idtable;
 IntTable inttable;
 StrTable stringtable;
+
+void print_string_table_stats(ostream& s)
+{
+  idtable.print_stats(s, "idtable");
+  stringtable.print_stats(s, "stringtable");
+  inttable.print_stats(s, "inttable");
+}
@@ -0,0 +1,16 @@
+(*
+ *  Counts down from 1000000 through a direct call in tail position.
+ *  Under -O the call is a jump, so the recursion runs in constant
+ *  stack; with -n it is a call again and does not (see tailcall_test in
+ *  the Makefile).
+ *)
+
+class Main inherits IO {
+    count(n : Int, acc : Int) : Int {
+        if n = 0 then acc else count(n - 1, acc + 1) fi
+    };
+
+    main() : Object {
+        out_int(count(1000000, 0)).out_string("\n")
+    };
+};